@@ -0,0 +1,32 @@
+#ifndef SIMPLE_WORLD_CREATOR_ANIMATION_DELTA_H_
+#define SIMPLE_WORLD_CREATOR_ANIMATION_DELTA_H_
+
+#include <ostream>
+
+#include <simple_world_creator/column_world.h>
+
+//Voxels that change between two frames of an animated world. Only the moving objects are
+//voxelized per frame; voxels they cover in both frames and voxels of the static world are
+//not part of the delta, so its size follows what moved rather than the size of the world.
+//
+//Delta files are little endian binary:
+//  char[8] 'SWCDELT1', uint32 frame, float64 time in seconds, float64 resolution, uint32 added runs, uint32 removed runs
+//  (added + removed) * 4 uint16 x, y, z begin, z end octree keys (depth 16), z end exclusive
+//  (0 stands for 65536), added runs first
+class AnimationDelta
+{
+public:
+  //all worlds have to be compacted
+  void compute(const ColumnWorld &previous, const ColumnWorld &current, const ColumnWorld &fixed);
+
+  size_t getNumAddedRuns() const;
+  size_t getNumRemovedRuns() const;
+  bool write(std::ostream &file, unsigned int frame, double time) const;
+
+private:
+  static void writeRuns(std::ostream &file, const ColumnWorld &world);
+
+  ColumnWorld added, removed, scratch;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_ANIMATION_DELTA_H_
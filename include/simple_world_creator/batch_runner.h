@@ -0,0 +1,40 @@
+#ifndef SIMPLE_WORLD_CREATOR_BATCH_RUNNER_H_
+#define SIMPLE_WORLD_CREATOR_BATCH_RUNNER_H_
+
+#include <string>
+#include <vector>
+
+struct BatchResult
+{
+  std::string fileName;
+  bool success;
+  double seconds;
+};
+
+//Creates the requested outputs for many world config files in one process. Worlds are
+//processed as independent jobs on a work-stealing thread pool; every worker keeps one
+//scratch column world whose buffers are reused from world to world.
+class BatchRunner
+{
+public:
+  BatchRunner(const std::vector<std::string> &options, int numThreads);
+
+  //source may be a directory, a glob pattern or a manifest file with one world file per line
+  bool collectWorldFiles(const std::string &source);
+  bool run();
+  void printReport() const;
+
+private:
+  bool collectDirectory(const std::string &directory);
+  bool collectGlob(const std::string &pattern);
+  bool collectManifest(const std::string &manifest);
+  static bool isOutputFile(const std::string &name);
+
+  std::vector<std::string> options;
+  int numThreads;
+  std::vector<std::string> worldFiles;
+  std::vector<BatchResult> results;
+  double totalSeconds;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_BATCH_RUNNER_H_
@@ -0,0 +1,42 @@
+#ifndef SIMPLE_WORLD_CREATOR_BULK_OCTREE_H_
+#define SIMPLE_WORLD_CREATOR_BULK_OCTREE_H_
+
+#include <octomap/octomap.h>
+
+#include <simple_world_creator/column_world.h>
+
+//OcTree that is built from a column world in one pass. Cubes are classified from the root down:
+//unknown cubes get no node, fully occupied or free cubes become leaves right away and only mixed
+//cubes are split. The result is the pruned tree without touching single voxels. A world held
+//completely by its dense grid is classified from the grid words (OR and AND of the z-words of a
+//cube), otherwise from the z-runs with one run cursor per column.
+class BulkOcTree : public octomap::OcTree
+{
+public:
+  BulkOcTree(double resolution);
+
+  //the tree has to be empty; with markFree, all voxels in the bounding box of the world that are
+  //not occupied are inserted as free, so the space outside the box is the only unknown space
+  void insertColumns(const ColumnWorld &columns, bool markFree = false);
+
+private:
+  enum CubeState
+  {
+    CUBE_UNKNOWN, CUBE_FREE, CUBE_OCCUPIED, CUBE_MIXED
+  };
+
+  //cube of size keys along every axis with its lower corner at key (x, y, z)
+  CubeState getCubeState(const ColumnWorld &columns, int x, int y, int z, int size);
+  CubeState getOccupancy(const ColumnWorld &columns, int x, int y, int z, int size);
+  void insertCube(octomap::OcTreeNode *node, CubeState state, const ColumnWorld &columns, int x, int y, int z, int size);
+
+  float occupiedLogOdds, freeLogOdds;
+  bool markFree;
+  int freeMin[3], freeMax[3];
+
+  const DenseGrid *dense;
+  //first run of every column that may reach into the cubes still to be classified
+  std::vector<const ZRun*> runCursors;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_BULK_OCTREE_H_
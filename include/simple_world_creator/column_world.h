@@ -0,0 +1,166 @@
+#ifndef SIMPLE_WORLD_CREATOR_COLUMN_WORLD_H_
+#define SIMPLE_WORLD_CREATOR_COLUMN_WORLD_H_
+
+#include <vector>
+#include <algorithm>
+
+#include <octomap/octomap.h>
+
+#include <simple_world_creator/primitive_store.h>
+#include <simple_world_creator/dense_grid.h>
+
+//half-open range [begin, end) of octree z keys inside one (x, y) column; end is an int, so that
+//runs reaching the top key end at ColumnWorld::KEY_LIMIT
+struct ZRun
+{
+  octomap::key_type begin;
+  int end;
+};
+
+//Voxel world stored as sorted z-runs per (x, y) column. Runs are collected with
+//addRun()/add*() and become queryable after compact(), which merges them into one
+//contiguous pool. Only non-empty columns are indexed: every row (x key) lists the y keys of its
+//columns, so memory follows the footprint of the world instead of its bounding rectangle.
+//Bounded worlds can reserve a dense bit grid first; runs inside it are then written as bits
+//and read back in sorted order by compact(), so no sort is needed for them.
+class ColumnWorld
+{
+public:
+  //one past the largest octree key
+  static const int KEY_LIMIT = 65536;
+
+  ColumnWorld();
+
+  void reset(double res);
+  void swap(ColumnWorld &other);
+  //has to be called on an empty world; the inclusive key box should cover everything that will be added
+  void reserveDense(const octomap::key_type min[3], const octomap::key_type max[3]);
+  bool hasDenseGrid() const;
+
+  //methods for filling the world
+  void addRun(octomap::key_type x, octomap::key_type y, octomap::key_type zBegin, int zEnd);
+  //primitives are rasterized by their shape kernel (see shape_kernels.h), only into the x key slab [slabBegin, slabEnd)
+  template<typename Kernel>
+  void addShape(const typename Kernel::Shape &shape, int slabBegin = 0, int slabEnd = KEY_LIMIT);
+  template<typename Kernel>
+  void addShapes(const typename Kernel::Columns &primitives, size_t begin, size_t end, const double offset[3], int slabBegin = 0,
+                 int slabEnd = KEY_LIMIT);
+  void addBox(double centerX, double centerY, double bottomZ, double sizeX, double sizeY, double sizeZ, double angle);
+  void stamp(const ColumnWorld &other, int offsetX, int offsetY, int offsetZ);
+  void merge(const ColumnWorld &other);
+  //replaces this world by the voxels of world that are not in other; both have to be compacted
+  void subtract(const ColumnWorld &world, const ColumnWorld &other);
+  void compact();
+
+  //methods for querying the compacted world
+  bool empty() const;
+  bool containsColumn(octomap::key_type x, octomap::key_type y) const;
+  bool isColumnOccupied(octomap::key_type x, octomap::key_type y) const;
+  bool isOccupied(octomap::key_type x, octomap::key_type y, octomap::key_type z) const;
+  bool isBandOccupied(octomap::key_type x, octomap::key_type y, int zBegin, int zEnd) const;
+  void getColumnRuns(octomap::key_type x, octomap::key_type y, const ZRun *&begin, const ZRun *&end) const;
+  size_t getNumRuns() const;
+  //the grid if it holds the whole compacted world, otherwise NULL
+  const DenseGrid* getDenseGrid() const;
+
+  //non-empty columns are numbered in (x, y) order; those of row x are [begin, end), sorted by y,
+  //so walking them visits only occupied columns
+  size_t getNumColumns() const;
+  void getRowColumns(int x, size_t &begin, size_t &end) const;
+  void getRowColumns(int x, int yBegin, int yEnd, size_t &begin, size_t &end) const;
+  octomap::key_type getColumnY(size_t column) const;
+  void getColumnRuns(size_t column, const ZRun *&begin, const ZRun *&end) const;
+  size_t memoryUsage() const;
+
+  //bounding box of all occupied voxels, z included
+  octomap::key_type getMinKey(int axis) const;
+  octomap::key_type getMaxKey(int axis) const;
+  double getMinCoord(int axis) const;
+  double getMaxCoord(int axis) const;
+
+  //methods for converting between metric coordinates and octree keys
+  double getResolution() const;
+  octomap::key_type coordToKey(double coordinate) const;
+  double keyToCoord(octomap::key_type key) const;
+  double keyToBoundaryCoord(int key) const;
+  bool coordsToKeySpan(double min, double max, int &begin, int &end) const;
+
+private:
+  struct PendingRun
+  {
+    octomap::key_type x, y;
+    ZRun run;
+  };
+
+  static bool comparePendingRuns(const PendingRun &a, const PendingRun &b);
+  void sortPendingRuns();
+  void queueDenseRuns();
+  void compactDense();
+  //the index is rebuilt for rows [minKey[0], minKey[0] + numRows) from runs appended in (x, y, z) order,
+  //overlapping runs of a column are merged
+  void clearIndex(size_t numRows);
+  void appendRun(octomap::key_type x, octomap::key_type y, const ZRun &run, size_t &nextRow);
+  void finishIndex(size_t &nextRow);
+  bool findColumn(octomap::key_type x, octomap::key_type y, size_t &column) const;
+
+  double resolution;
+
+  std::vector<PendingRun> pending;
+  std::vector<double> rowSpans;
+
+  octomap::key_type minKey[3], maxKey[3];
+  std::vector<unsigned int> rowOffsets;
+  std::vector<octomap::key_type> columnKeys;
+  std::vector<unsigned int> columnOffsets;
+  std::vector<ZRun> runs;
+
+  DenseGrid dense;
+  //denseComplete: every run added since reserveDense() went into the grid
+  //denseDirty: the grid holds runs that were not compacted yet
+  bool denseComplete, denseDirty;
+};
+
+template<typename Kernel>
+void ColumnWorld::addShape(const typename Kernel::Shape &shape, int slabBegin, int slabEnd)
+{
+  int xBegin, xEnd;
+  if (!coordsToKeySpan(shape.min[0], shape.max[0], xBegin, xEnd))
+    return;
+
+  const int slabXBegin = std::max<int>(xBegin, slabBegin);
+  const int slabXEnd = std::min<int>(xEnd, slabEnd);
+  for (int x = slabXBegin; x < slabXEnd; ++x)
+  {
+    const double coordX = keyToCoord(x);
+    rowSpans.clear();
+    Kernel::getRowSpans(shape, coordX, rowSpans);
+
+    for (size_t span = 0; span + 1 < rowSpans.size(); span += 2)
+    {
+      int yBegin, yEnd;
+      if (!coordsToKeySpan(rowSpans[span], rowSpans[span + 1], yBegin, yEnd))
+        continue;
+
+      for (int y = yBegin; y < yEnd; ++y)
+      {
+        double zMin, zMax;
+        int zBegin, zEnd;
+        if (Kernel::getColumnSpan(shape, coordX, keyToCoord(y), zMin, zMax) && coordsToKeySpan(zMin, zMax, zBegin, zEnd))
+          addRun(x, y, zBegin, zEnd);
+      }
+    }
+  }
+}
+
+template<typename Kernel>
+void ColumnWorld::addShapes(const typename Kernel::Columns &primitives, size_t begin, size_t end, const double offset[3], int slabBegin, int slabEnd)
+{
+  typename Kernel::Shape shape;
+  for (size_t i = begin; i < end; ++i)
+  {
+    Kernel::getShape(primitives, i, offset, shape);
+    addShape<Kernel>(shape, slabBegin, slabEnd);
+  }
+}
+
+#endif // SIMPLE_WORLD_CREATOR_COLUMN_WORLD_H_
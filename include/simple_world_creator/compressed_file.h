@@ -0,0 +1,149 @@
+#ifndef SIMPLE_WORLD_CREATOR_COMPRESSED_FILE_H_
+#define SIMPLE_WORLD_CREATOR_COMPRESSED_FILE_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+enum Compression
+{
+  COMPRESSION_NONE, COMPRESSION_ZSTD, COMPRESSION_LZ4
+};
+
+//Stream buffer that hands its data in blocks to a background thread, which compresses and writes
+//them while the caller keeps generating. At most MAX_QUEUED_BLOCKS blocks wait at any time, so
+//memory stays bounded however large the file gets. zstd and LZ4 output are standard frames, which
+//the zstd and lz4 command line tools read as well. Flushing does not cut blocks, so std::endl is cheap.
+class CompressionBuffer : public std::streambuf
+{
+public:
+  CompressionBuffer();
+  ~CompressionBuffer();
+
+  bool open(const std::string &fileName, Compression compression, int level);
+  //returns false if anything could not be compressed or written
+  bool close();
+
+  uint64_t getInputBytes() const;
+  uint64_t getOutputBytes() const;
+
+protected:
+  int overflow(int c);
+  std::streamsize xsputn(const char *data, std::streamsize size);
+
+private:
+  enum
+  {
+    BLOCK_SIZE = 1 << 20, MAX_QUEUED_BLOCKS = 4
+  };
+
+  CompressionBuffer(const CompressionBuffer&);
+  CompressionBuffer& operator=(const CompressionBuffer&);
+
+  void handOver();
+  void compressLoop();
+  bool compressBlock(const std::vector<char> &block, bool last);
+  bool writeOutput(const char *data, size_t size);
+
+  std::ofstream file;
+  Compression compression;
+  int level;
+  void *context;
+  std::vector<char> output;
+
+  std::vector<char> block;
+  std::deque<std::vector<char> > queuedBlocks;
+  std::vector<std::vector<char> > freeBlocks;
+  std::mutex mutex;
+  std::condition_variable queueCondition;
+  std::thread worker;
+  bool finished, failed;
+
+  uint64_t inputBytes, outputBytes;
+};
+
+//Output file stream for all world artifacts; the file name gets the suffix of the compression.
+class CompressedOutputFile : public std::ostream
+{
+public:
+  CompressedOutputFile();
+
+  static bool parseCompression(const std::string &value, Compression &compression, int &level);
+  static bool isAvailable(Compression compression);
+  static std::string getName(Compression compression);
+  static std::string getSuffix(Compression compression);
+
+  bool open(const std::string &fileName, Compression compression, int level);
+  bool close();
+  const std::string& getFileName() const;
+
+  uint64_t getInputBytes() const;
+  uint64_t getOutputBytes() const;
+
+private:
+  CompressionBuffer buffer;
+  std::string fileName;
+};
+
+//Stream buffer that reads plain, zstd or LZ4 files, told apart by their frame magic numbers.
+class DecompressionBuffer : public std::streambuf
+{
+public:
+  DecompressionBuffer();
+  ~DecompressionBuffer();
+
+  bool open(const std::string &fileName);
+  void close();
+  //true if the data was corrupt or ended within a frame; reading stops there as if at the end of the file
+  bool hasFailed() const;
+
+protected:
+  int underflow();
+
+private:
+  enum
+  {
+    CHUNK_SIZE = 1 << 17
+  };
+
+  DecompressionBuffer(const DecompressionBuffer&);
+  DecompressionBuffer& operator=(const DecompressionBuffer&);
+
+  bool fillInput();
+  size_t decompress();
+
+  std::ifstream file;
+  Compression compression;
+  void *context;
+  std::vector<char> input, output;
+  size_t inputBegin, inputEnd;
+  bool frameComplete, failed;
+};
+
+//Input file stream that decompresses transparently, e.g. for loading written octrees.
+class CompressedInputFile : public std::istream
+{
+public:
+  CompressedInputFile();
+
+  //name without '.zst' or '.lz4', e.g. to tell the file type
+  static std::string stripSuffix(const std::string &fileName);
+  //writes the plain content of a compressed file next to it, without the suffix
+  static bool decompressFile(const std::string &fileName);
+
+  //fileName may also name the file without its compression suffix
+  bool open(const std::string &fileName);
+  //true if the compressed data was corrupt or truncated, see DecompressionBuffer::hasFailed()
+  bool hasFailed() const;
+
+private:
+  DecompressionBuffer buffer;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_COMPRESSED_FILE_H_
@@ -0,0 +1,51 @@
+#ifndef SIMPLE_WORLD_CREATOR_DENSE_GRID_H_
+#define SIMPLE_WORLD_CREATOR_DENSE_GRID_H_
+
+#include <vector>
+#include <stdint.h>
+
+#include <octomap/octomap.h>
+
+//Bit-packed occupancy of a fixed box of octree keys. Every (x, y) column owns a contiguous block
+//of 64 bit words along z, so whole z-runs are set and queried with a few masked word operations.
+class DenseGrid
+{
+public:
+  DenseGrid();
+
+  //bytes needed for the inclusive key box [min, max]
+  static size_t getMemoryUsage(const octomap::key_type min[3], const octomap::key_type max[3]);
+
+  void reset(const octomap::key_type min[3], const octomap::key_type max[3]);
+  void clear();
+  void swap(DenseGrid &other);
+
+  bool isAllocated() const;
+  bool containsColumn(octomap::key_type x, octomap::key_type y) const;
+  bool containsRun(octomap::key_type x, octomap::key_type y, octomap::key_type zBegin, int zEnd) const;
+
+  //half-open z key ranges, the run has to lie inside the grid
+  void setRun(octomap::key_type x, octomap::key_type y, octomap::key_type zBegin, int zEnd);
+  //the band may reach beyond the grid, keys outside count as free
+  bool isBandOccupied(octomap::key_type x, octomap::key_type y, int zBegin, int zEnd) const;
+  //OR (any) and AND (all) of the bits in the band, from whole words where the band covers them
+  void getBandState(octomap::key_type x, octomap::key_type y, int zBegin, int zEnd, bool &any, bool &all) const;
+  //finds the first run of the column that begins at or above z and returns it in [begin, end)
+  bool findRun(octomap::key_type x, octomap::key_type y, int z, octomap::key_type &begin, int &end) const;
+
+  octomap::key_type getMinKey(int axis) const;
+  octomap::key_type getMaxKey(int axis) const;
+  size_t memoryUsage() const;
+
+private:
+  const uint64_t* getColumn(octomap::key_type x, octomap::key_type y) const;
+  int findBit(const uint64_t *column, int bit, bool value) const;
+
+  octomap::key_type minKey[3], maxKey[3];
+  size_t sizeY;
+  int sizeZ;
+  size_t wordsPerColumn;
+  std::vector<uint64_t> words;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_DENSE_GRID_H_
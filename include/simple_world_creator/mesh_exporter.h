@@ -0,0 +1,55 @@
+#ifndef SIMPLE_WORLD_CREATOR_MESH_EXPORTER_H_
+#define SIMPLE_WORLD_CREATOR_MESH_EXPORTER_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <simple_world_creator/column_world.h>
+
+//Writes the surface of a ColumnWorld as a triangle mesh. The faces of one direction are
+//buffered as spans (runs along one axis), sorted, and identical spans on consecutive rows
+//are written as one rectangle. This is not a maximal merge, and one direction is held in
+//memory at a time, but the triangles of the mesh never are.
+class MeshExporter
+{
+public:
+  MeshExporter(const ColumnWorld &world);
+
+  //stl needs the triangle count up front; streams that cannot seek back get a counting pass first
+  bool writeSTL(std::ostream &file);
+  bool writeOBJ(std::ostream &file);
+
+  size_t getNumTriangles() const;
+
+private:
+  enum Format
+  {
+    FORMAT_STL, FORMAT_OBJ, FORMAT_COUNT
+  };
+
+  //[begin, end) along the span axis, at 'row' along the row axis, on the face plane 'plane'
+  struct FaceSpan
+  {
+    int plane;
+    int begin, end;
+    int row;
+  };
+
+  static bool compareByRow(const FaceSpan &a, const FaceSpan &b);
+  static bool compareBySpan(const FaceSpan &a, const FaceSpan &b);
+
+  void writeFaces();
+  void collectTopBottomFaces(std::vector<FaceSpan> &bottom, std::vector<FaceSpan> &top);
+  void collectSideFaces(int axis, std::vector<FaceSpan> &negative, std::vector<FaceSpan> &positive);
+  void joinAdjacentCells(std::vector<FaceSpan> &cells);
+  void mergeAndWriteSpans(std::vector<FaceSpan> &spans, int axis, bool positive, int spanAxis, int rowAxis);
+  void writeQuad(int axis, bool positive, int plane, const int begin[3], const int end[3]);
+
+  const ColumnWorld &world;
+  Format format;
+  std::ostream *file;
+  size_t numQuads;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_MESH_EXPORTER_H_
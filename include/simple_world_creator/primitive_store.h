@@ -0,0 +1,138 @@
+#ifndef SIMPLE_WORLD_CREATOR_PRIMITIVE_STORE_H_
+#define SIMPLE_WORLD_CREATOR_PRIMITIVE_STORE_H_
+
+#include <string>
+#include <vector>
+
+struct ObjectBox;
+struct ObjectSphere;
+struct ObjectCylinder;
+struct ObjectPolygonPrism;
+struct ObjectCapsule;
+
+#ifdef SIMPLE_WORLD_CREATOR_FLOAT_PRIMITIVES
+typedef float PrimitiveScalar;
+#else
+typedef double PrimitiveScalar;
+#endif
+
+//All primitive names back to back in one buffer, each terminated by '\0'. Equal names share one entry.
+//The lookup table only holds offsets into the buffer, so no name is ever stored twice.
+class NameArena
+{
+public:
+  NameArena();
+
+  unsigned int intern(const std::string &name);
+  const char* get(unsigned int id) const;
+
+  //drops the lookup table once no more names are added; a later intern() rebuilds it from the buffer
+  void shrinkToFit();
+  size_t memoryUsage() const;
+
+private:
+  static size_t hashName(const char *name, size_t length);
+  void rehash(size_t numSlots);
+
+  std::string data;
+  size_t numNames;
+  std::vector<unsigned int> slots; //open addressing, offset + 1 per slot, 0 for free slots
+};
+
+//primitive parameters as one column per field, so that passes only touch the fields they need
+struct BoxColumns
+{
+  std::vector<PrimitiveScalar> centerX, centerY, bottomZ;
+  std::vector<PrimitiveScalar> sizeX, sizeY, sizeZ;
+  std::vector<PrimitiveScalar> angle;
+  std::vector<unsigned int> name;
+
+  size_t size() const
+  {
+    return centerX.size();
+  }
+};
+
+struct SphereColumns
+{
+  std::vector<PrimitiveScalar> centerX, centerY, bottomZ;
+  std::vector<PrimitiveScalar> radius;
+  std::vector<unsigned int> name;
+
+  size_t size() const
+  {
+    return centerX.size();
+  }
+};
+
+struct CylinderColumns
+{
+  std::vector<PrimitiveScalar> centerX, centerY, bottomZ;
+  std::vector<PrimitiveScalar> radius, height;
+  std::vector<unsigned int> name;
+
+  size_t size() const
+  {
+    return centerX.size();
+  }
+};
+
+//the vertices of all prisms are stored back to back, each prism refers to its range
+struct PolygonPrismColumns
+{
+  std::vector<unsigned int> firstVertex, numVertices;
+  std::vector<PrimitiveScalar> vertexX, vertexY;
+  std::vector<PrimitiveScalar> bottomZ, height;
+  std::vector<unsigned int> name;
+
+  size_t size() const
+  {
+    return bottomZ.size();
+  }
+};
+
+struct CapsuleColumns
+{
+  std::vector<PrimitiveScalar> startX, startY, startZ;
+  std::vector<PrimitiveScalar> endX, endY, endZ;
+  std::vector<PrimitiveScalar> radius;
+  std::vector<unsigned int> name;
+
+  size_t size() const
+  {
+    return startX.size();
+  }
+};
+
+class PrimitiveStore
+{
+public:
+  BoxColumns boxes;
+  SphereColumns spheres;
+  CylinderColumns cylinders;
+  PolygonPrismColumns polygonPrisms;
+  CapsuleColumns capsules;
+  NameArena names;
+
+  void reserve(size_t numBoxes, size_t numSpheres, size_t numCylinders, size_t numPolygonPrisms, size_t numCapsules);
+  void shrinkToFit();
+
+  void addBox(const ObjectBox &box);
+  void addSphere(const ObjectSphere &sphere);
+  void addCylinder(const ObjectCylinder &cylinder);
+  void addPolygonPrism(const ObjectPolygonPrism &polygonPrism);
+  void addCapsule(const ObjectCapsule &capsule);
+
+  //materialize one primitive, e.g. for writing it to a file
+  void getBox(size_t i, ObjectBox &box) const;
+  void getSphere(size_t i, ObjectSphere &sphere) const;
+  void getCylinder(size_t i, ObjectCylinder &cylinder) const;
+  void getPolygonPrism(size_t i, ObjectPolygonPrism &polygonPrism) const;
+  void getCapsule(size_t i, ObjectCapsule &capsule) const;
+
+  size_t size() const;
+  bool empty() const;
+  size_t memoryUsage() const;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_PRIMITIVE_STORE_H_
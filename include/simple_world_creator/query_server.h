@@ -0,0 +1,26 @@
+#ifndef SIMPLE_WORLD_CREATOR_QUERY_SERVER_H_
+#define SIMPLE_WORLD_CREATOR_QUERY_SERVER_H_
+
+#include <ros/ros.h>
+
+#include <octomap/octomap.h>
+
+#include <simple_world_creator/QueryWorld.h>
+#include <simple_world_creator/world_query.h>
+
+//Offers a WorldQuery as the ROS service '~query_world', so that one resident world answers
+//the queries of all tools instead of every tool loading the octree itself.
+class QueryServer
+{
+public:
+  QueryServer(const octomap::OcTree &octree, int numThreads = 0);
+
+  bool handleQuery(simple_world_creator::QueryWorld::Request &request, simple_world_creator::QueryWorld::Response &response);
+
+private:
+  WorldQuery query;
+  ros::NodeHandle nodeHandle;
+  ros::ServiceServer service;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_QUERY_SERVER_H_
@@ -0,0 +1,102 @@
+#ifndef SIMPLE_WORLD_CREATOR_SCAN_SIMULATOR_H_
+#define SIMPLE_WORLD_CREATOR_SCAN_SIMULATOR_H_
+
+#include <string>
+#include <ostream>
+#include <vector>
+
+#include <simple_world_creator/primitive_store.h>
+#include <simple_world_creator/shape_kernels.h>
+#include <simple_world_creator/thread_pool.h>
+
+enum ScanType
+{
+  SCAN_LASER_2D, SCAN_MULTI_BEAM, SCAN_DEPTH_CAMERA
+};
+
+//one '-scan' block of the config file: a scan pattern that is cast from every pose
+struct ObjectScan
+{
+  std::string name;
+  ScanType type;
+  std::vector<double> poses; //x y z roll pitch yaw per pose, angles in radians
+  double horizontal[3]; //first and last angle in radians, number of samples
+  double vertical[3]; //first and last elevation in radians, number of beams (multi_beam)
+  double image[3]; //width, height and horizontal field of view in radians (depth_camera)
+  double range[2];
+  bool points;
+};
+
+//Casts simulated laser and depth camera scans analytically against the primitives. The shapes are
+//kept in a bounding volume hierarchy; rays of one pose are traced in packets of neighbouring
+//directions that walk the hierarchy together, and packets are spread over a thread pool.
+//
+//Scan files are little endian binary:
+//  char[8] 'SWCSCAN1', uint32 type, uint32 output (0 ranges, 1 points), uint32 poses, uint32 rays per pose
+//  rays * 3 float32 ray directions in the sensor frame (x forward, y left, z up)
+//  per pose 6 float32 (x y z roll pitch yaw, radians), followed by
+//    ranges: rays float32 hit distances along the directions, NaN without return
+//    points: uint32 count and count * 3 float32 hit points in the sensor frame
+//Depth camera directions have x = 1, so their distances are depths along the optical axis.
+class ScanSimulator
+{
+public:
+  enum
+  {
+    FIELD_NAME = 1, FIELD_TYPE = 2, FIELD_POSES = 4, FIELD_HORIZONTAL = 8, FIELD_VERTICAL = 16, FIELD_IMAGE = 32, FIELD_RANGE = 64, FIELD_OUTPUT = 128
+  };
+
+  //'-scan' blocks are parsed like shapes, the required fields depend on the scan type
+  static unsigned int readField(const std::string &key, const std::string &value, ObjectScan &scan);
+  static unsigned int getRequiredFields(const ObjectScan &scan);
+  static void getRayDirections(const ObjectScan &scan, std::vector<double> &directions);
+
+  ScanSimulator();
+
+  //polygon prism shapes point into the store, so it has to outlive the simulator
+  void addPrimitives(const PrimitiveStore &store, const double offset[3]);
+  void build();
+  size_t getNumPrimitives() const;
+
+  //ranges receive the hit distance along each direction, or NaN if nothing is hit within [rangeMin, rangeMax)
+  void castRays(const double pose[6], const double *directions, size_t numRays, double rangeMin, double rangeMax, float *ranges) const;
+  bool writeScan(const ObjectScan &scan, std::ostream &file, ThreadPool &pool) const;
+
+private:
+  enum
+  {
+    PACKET_SIZE = 8, LEAF_SIZE = 4, MAX_DEPTH = 64
+  };
+
+  struct PrimitiveRef
+  {
+    double min[3], max[3], center[3];
+    int kernel;
+    unsigned int index;
+  };
+
+  struct Node
+  {
+    double min[3], max[3];
+    unsigned int first; //leaf: first primitive reference, inner node: index of the second child
+    unsigned int count; //number of primitive references, 0 for inner nodes
+    int axis; //split axis of inner nodes
+  };
+
+  template<typename Kernel>
+  void addShapes(const PrimitiveStore &store, const double offset[3], int kernel, std::vector<typename Kernel::Shape> &shapes);
+  unsigned int buildNode(size_t begin, size_t end, int depth);
+  void castPacket(const double origin[3], const double directions[][3], int numRays, double *t) const;
+  bool intersect(const PrimitiveRef &ref, const double origin[3], const double direction[3], double &t) const;
+
+  std::vector<BoxKernel::Shape> boxes;
+  std::vector<SphereKernel::Shape> spheres;
+  std::vector<CylinderKernel::Shape> cylinders;
+  std::vector<PolygonPrismKernel::Shape> polygonPrisms;
+  std::vector<CapsuleKernel::Shape> capsules;
+
+  std::vector<PrimitiveRef> refs;
+  std::vector<Node> nodes;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_SCAN_SIMULATOR_H_
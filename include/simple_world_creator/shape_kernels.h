@@ -0,0 +1,1083 @@
+#ifndef SIMPLE_WORLD_CREATOR_SHAPE_KERNELS_H_
+#define SIMPLE_WORLD_CREATOR_SHAPE_KERNELS_H_
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#include <simple_world_creator/primitive_store.h>
+
+struct ObjectBox
+{
+  std::string name;
+  double bottomCenter[3];
+  double size[3];
+  double angle;
+};
+
+struct ObjectLineBox
+{
+  std::string name;
+  double start[2];
+  double end[2];
+  double thickness;
+  double height[2];
+};
+
+struct ObjectSphere
+{
+  std::string name;
+  double bottom[3];
+  double radius;
+};
+
+struct ObjectCylinder
+{
+  std::string name;
+  double bottom[3];
+  double height, radius;
+};
+
+//polygon in the xy plane (x0 y0 x1 y1 ...), extruded from bottom by height
+struct ObjectPolygonPrism
+{
+  std::string name;
+  std::vector<double> points;
+  double bottom;
+  double height;
+};
+
+//all points within radius of the segment from start to end
+struct ObjectCapsule
+{
+  std::string name;
+  double start[3];
+  double end[3];
+  double radius;
+};
+
+//one sdf geometry with its pose in world coordinates, e.g. type 'box' with the parameter ('size', '1 2 3')
+struct GazeboGeometry
+{
+  std::string pose;
+  std::string type;
+  std::vector<std::pair<std::string, std::string> > parameters;
+};
+
+//Shape kernels bundle everything the pipeline needs to know about one primitive type. They are
+//structs of static functions; the config parser, the voxelization queue, the column rasterizer and
+//the gazebo writers are templates over them, so the inner loops are specialized per shape.
+//
+//  Object, FIELDS, readField()  parse one '-<shape>' block of the config file
+//  Columns, getColumns(), add() store the primitive in a PrimitiveStore
+//  Shape, getShape()            one primitive prepared for rasterization, including its bounds
+//  getRowSpans()                y intervals of the footprint at a given x, as (begin, end) pairs
+//  getColumnSpan()              inside test and z interval at a given (x, y)
+//  getVolume(), getAnchor()     volume for scheduling and reference point for batching
+//  getGazeboGeometries()        sdf geometries that make up the primitive
+//  intersectRay()               closest entry of the ray origin + t * direction, for simulated scans
+//  getObject(), transform()     copy of a stored primitive moved by an (x, y, z, yaw) pose, for animations
+struct ShapeKernelBase
+{
+  //row spans are widened by this much, so that boundary voxels are decided by getColumnSpan() alone
+  static double getSpanTolerance()
+  {
+    return 1e-9;
+  }
+
+  //strtod() instead of a stream per field, which dominated parsing large worlds
+  static bool parseValues(const std::string &value, double *values, int n)
+  {
+    const char *begin = value.c_str();
+    for (int i = 0; i < n; ++i)
+    {
+      char *end;
+      values[i] = std::strtod(begin, &end);
+      if (end == begin)
+        return false;
+      begin = end;
+    }
+    return true;
+  }
+
+  //restricts [begin, end] to the values t with lower <= a + b * t <= upper
+  static void clipLinearSpan(double a, double b, double lower, double upper, double &begin, double &end)
+  {
+    lower -= getSpanTolerance();
+    upper += getSpanTolerance();
+
+    if (std::abs(b) < 1e-12)
+    {
+      if (a < lower || a > upper)
+      {
+        begin = HUGE_VAL;
+        end = -HUGE_VAL;
+      }
+      return;
+    }
+
+    double t0 = (lower - a) / b, t1 = (upper - a) / b;
+    if (t0 > t1)
+      std::swap(t0, t1);
+    begin = std::max(begin, t0);
+    end = std::min(end, t1);
+  }
+
+  //restricts [begin, end] to the values t with a * t^2 + b * t + c <= 0, for a >= 0
+  static void clipQuadraticSpan(double a, double b, double c, double &begin, double &end)
+  {
+    const double discriminant = b * b - 4.0 * a * c;
+    if (a < 1e-12 ? c > 0.0 : discriminant < 0.0)
+    {
+      begin = HUGE_VAL;
+      end = -HUGE_VAL;
+      return;
+    }
+    if (a < 1e-12)
+      return;
+
+    const double root = sqrt(discriminant);
+    begin = std::max(begin, (-b - root) / (2.0 * a));
+    end = std::min(end, (-b + root) / (2.0 * a));
+  }
+
+  //takes the entry of the ray span [begin, end] as the new closest hit if it lies before t
+  static bool acceptRaySpan(double begin, double end, double &t)
+  {
+    if (begin > end || begin >= t)
+      return false;
+    t = begin;
+    return true;
+  }
+
+  //rotates (x, y) about the origin by the yaw of an (x, y, z, yaw) pose, then translates it
+  static void transformPoint(const double pose[4], double &x, double &y)
+  {
+    const double cosYaw = cos(pose[3]), sinYaw = sin(pose[3]);
+    const double rotatedX = cosYaw * x - sinYaw * y;
+    y = sinYaw * x + cosYaw * y + pose[1];
+    x = rotatedX + pose[0];
+  }
+
+  static double dot(const double a[3], const double b[3])
+  {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+
+  //closest entry of a ray into a sphere, see intersectRay()
+  static bool intersectSphere(const double center[3], double radiusSquared, const double origin[3], const double direction[3], double &t)
+  {
+    const double offset[3] = {origin[0] - center[0], origin[1] - center[1], origin[2] - center[2]};
+    double begin = 0.0, end = t;
+    clipQuadraticSpan(dot(direction, direction), 2.0 * dot(offset, direction), dot(offset, offset) - radiusSquared, begin, end);
+    return acceptRaySpan(begin, end, t);
+  }
+
+  //half length of the chord at distance d from the center of a circle, slightly widened
+  static bool getChordHalfLength(double d, double radius, double &halfLength)
+  {
+    const double radiusSquared = radius * radius;
+    const double rest = radiusSquared - d * d;
+    if (rest < 0.0)
+      return false;
+
+    //the square root amplifies rounding near the tangent, so the slack is added before it
+    halfLength = sqrt(rest + 1e-12 * radiusSquared) + getSpanTolerance();
+    return true;
+  }
+
+  static void addSpan(double begin, double end, std::vector<double> &spans)
+  {
+    if (begin > end)
+      return;
+    spans.push_back(begin);
+    spans.push_back(end);
+  }
+
+  static std::string formatValues(const double *values, int n)
+  {
+    std::ostringstream oss;
+    for (int i = 0; i < n; ++i)
+      oss << (i > 0 ? " " : "") << values[i];
+    return oss.str();
+  }
+
+  static std::string formatPose(double x, double y, double z, double roll, double pitch, double yaw)
+  {
+    const double pose[6] = {x, y, z, roll, pitch, yaw};
+    return formatValues(pose, 6);
+  }
+};
+
+struct BoxKernel : ShapeKernelBase
+{
+  typedef ObjectBox Object;
+  typedef BoxColumns Columns;
+
+  enum
+  {
+    FIELD_NAME = 1, FIELD_BOTTOM = 2, FIELD_SIZE = 4, FIELD_ANGLE = 8, FIELDS = 15
+  };
+
+  static unsigned int readField(const std::string &key, const std::string &value, Object &box)
+  {
+    if (key == "name")
+    {
+      box.name = value;
+      return FIELD_NAME;
+    }
+    else if (key == "bottom_center")
+      return parseValues(value, box.bottomCenter, 3) ? FIELD_BOTTOM : 0;
+    else if (key == "size")
+      return parseValues(value, box.size, 3) ? FIELD_SIZE : 0;
+    else if (key == "angle" && parseValues(value, &box.angle, 1))
+    {
+      box.angle = box.angle * M_PI / 180.0;
+      return FIELD_ANGLE;
+    }
+    return 0;
+  }
+
+  static const Columns& getColumns(const PrimitiveStore &store)
+  {
+    return store.boxes;
+  }
+
+  static void add(PrimitiveStore &store, const Object &box)
+  {
+    store.addBox(box);
+  }
+
+  static void getObject(const PrimitiveStore &store, size_t i, Object &box)
+  {
+    store.getBox(i, box);
+  }
+
+  static void transform(Object &box, const double pose[4])
+  {
+    transformPoint(pose, box.bottomCenter[0], box.bottomCenter[1]);
+    box.bottomCenter[2] += pose[2];
+    box.angle += pose[3];
+  }
+
+  struct Shape
+  {
+    double center[2];
+    double size[2];
+    double cosAngle, sinAngle;
+    double min[3], max[3];
+  };
+
+  static void getShape(double centerX, double centerY, double bottomZ, double sizeX, double sizeY, double sizeZ, double angle, Shape &box)
+  {
+    box.center[0] = centerX;
+    box.center[1] = centerY;
+    box.size[0] = sizeX;
+    box.size[1] = sizeY;
+    box.cosAngle = cos(-angle);
+    box.sinAngle = sin(-angle);
+
+    const double halfX = 0.5 * (std::abs(sizeX * box.cosAngle) + std::abs(sizeY * box.sinAngle));
+    const double halfY = 0.5 * (std::abs(sizeX * box.sinAngle) + std::abs(sizeY * box.cosAngle));
+    box.min[0] = centerX - halfX;
+    box.max[0] = centerX + halfX;
+    box.min[1] = centerY - halfY;
+    box.max[1] = centerY + halfY;
+    box.min[2] = bottomZ;
+    box.max[2] = bottomZ + sizeZ;
+  }
+
+  static void getShape(const Columns &boxes, size_t i, const double offset[3], Shape &box)
+  {
+    getShape(boxes.centerX[i] + offset[0], boxes.centerY[i] + offset[1], boxes.bottomZ[i] + offset[2], boxes.sizeX[i], boxes.sizeY[i], boxes.sizeZ[i],
+             boxes.angle[i], box);
+  }
+
+  static void getRowSpans(const Shape &box, double x, std::vector<double> &spans)
+  {
+    //the local x and y coordinates of the box are linear in y along the row
+    const double dx = x - box.center[0];
+    double begin = box.min[1], end = box.max[1];
+    clipLinearSpan(dx * box.cosAngle + box.center[1] * box.sinAngle, -box.sinAngle, -0.5 * box.size[0], 0.5 * box.size[0], begin, end);
+    clipLinearSpan(dx * box.sinAngle - box.center[1] * box.cosAngle, box.cosAngle, -0.5 * box.size[1], 0.5 * box.size[1], begin, end);
+    addSpan(begin, end, spans);
+  }
+
+  static bool getColumnSpan(const Shape &box, double x, double y, double &zBegin, double &zEnd)
+  {
+    const double dx = x - box.center[0];
+    const double dy = y - box.center[1];
+    const double xTrans = dx * box.cosAngle - dy * box.sinAngle;
+    const double yTrans = dx * box.sinAngle + dy * box.cosAngle;
+
+    if (xTrans < -0.5 * box.size[0] || xTrans > 0.5 * box.size[0] || yTrans < -0.5 * box.size[1] || yTrans > 0.5 * box.size[1])
+      return false;
+
+    zBegin = box.min[2];
+    zEnd = box.max[2];
+    return true;
+  }
+
+  static bool intersectRay(const Shape &box, const double origin[3], const double direction[3], double &t)
+  {
+    //the local box coordinates are linear along the ray, as they are along a row
+    const double dx = origin[0] - box.center[0], dy = origin[1] - box.center[1];
+    double begin = 0.0, end = t;
+    clipLinearSpan(dx * box.cosAngle - dy * box.sinAngle, direction[0] * box.cosAngle - direction[1] * box.sinAngle, -0.5 * box.size[0],
+                   0.5 * box.size[0], begin, end);
+    clipLinearSpan(dx * box.sinAngle + dy * box.cosAngle, direction[0] * box.sinAngle + direction[1] * box.cosAngle, -0.5 * box.size[1],
+                   0.5 * box.size[1], begin, end);
+    clipLinearSpan(origin[2], direction[2], box.min[2], box.max[2], begin, end);
+    return acceptRaySpan(begin, end, t);
+  }
+
+  static double getVolume(const Columns &boxes, size_t i)
+  {
+    return boxes.sizeX[i] * boxes.sizeY[i] * boxes.sizeZ[i];
+  }
+
+  static void getAnchor(const Columns &boxes, size_t i, double anchor[2])
+  {
+    anchor[0] = boxes.centerX[i];
+    anchor[1] = boxes.centerY[i];
+  }
+
+  static void getGazeboGeometries(const Columns &boxes, size_t i, std::vector<GazeboGeometry> &geometries)
+  {
+    const double size[3] = {boxes.sizeX[i], boxes.sizeY[i], boxes.sizeZ[i]};
+    GazeboGeometry geometry;
+    geometry.pose = formatPose(boxes.centerX[i], boxes.centerY[i], boxes.bottomZ[i] + 0.5 * size[2], 0.0, 0.0, boxes.angle[i]);
+    geometry.type = "box";
+    geometry.parameters.push_back(std::make_pair(std::string("size"), formatValues(size, 3)));
+    geometries.push_back(geometry);
+  }
+};
+
+//walls given by their end points; they are stored as boxes
+struct LineBoxKernel : ShapeKernelBase
+{
+  typedef ObjectLineBox Object;
+
+  enum
+  {
+    FIELD_NAME = 1, FIELD_START = 2, FIELD_END = 4, FIELD_THICKNESS = 8, FIELD_HEIGHT = 16, FIELDS = 31
+  };
+
+  static unsigned int readField(const std::string &key, const std::string &value, Object &lineBox)
+  {
+    if (key == "name")
+    {
+      lineBox.name = value;
+      return FIELD_NAME;
+    }
+    else if (key == "start")
+      return parseValues(value, lineBox.start, 2) ? FIELD_START : 0;
+    else if (key == "end")
+      return parseValues(value, lineBox.end, 2) ? FIELD_END : 0;
+    else if (key == "thickness")
+      return parseValues(value, &lineBox.thickness, 1) ? FIELD_THICKNESS : 0;
+    else if (key == "height")
+      return parseValues(value, lineBox.height, 2) ? FIELD_HEIGHT : 0;
+    return 0;
+  }
+
+  static void add(PrimitiveStore &store, const Object &lineBox)
+  {
+    ObjectBox box;
+    box.name = lineBox.name;
+
+    box.bottomCenter[0] = 0.5 * (lineBox.start[0] + lineBox.end[0]);
+    box.bottomCenter[1] = 0.5 * (lineBox.start[1] + lineBox.end[1]);
+    box.bottomCenter[2] = lineBox.height[0];
+
+    box.size[0] = lineBox.thickness;
+    box.size[1] = sqrt(pow(lineBox.start[0] - lineBox.end[0], 2) + pow(lineBox.start[1] - lineBox.end[1], 2));
+    box.size[2] = lineBox.height[1] - lineBox.height[0];
+
+    box.angle = atan2(lineBox.end[0] - lineBox.start[0], -lineBox.end[1] + lineBox.start[1]);
+    store.addBox(box);
+  }
+};
+
+struct SphereKernel : ShapeKernelBase
+{
+  typedef ObjectSphere Object;
+  typedef SphereColumns Columns;
+
+  enum
+  {
+    FIELD_NAME = 1, FIELD_BOTTOM = 2, FIELD_RADIUS = 4, FIELDS = 7
+  };
+
+  static unsigned int readField(const std::string &key, const std::string &value, Object &sphere)
+  {
+    if (key == "name")
+    {
+      sphere.name = value;
+      return FIELD_NAME;
+    }
+    else if (key == "bottom")
+      return parseValues(value, sphere.bottom, 3) ? FIELD_BOTTOM : 0;
+    else if (key == "radius")
+      return parseValues(value, &sphere.radius, 1) ? FIELD_RADIUS : 0;
+    return 0;
+  }
+
+  static const Columns& getColumns(const PrimitiveStore &store)
+  {
+    return store.spheres;
+  }
+
+  static void add(PrimitiveStore &store, const Object &sphere)
+  {
+    store.addSphere(sphere);
+  }
+
+  static void getObject(const PrimitiveStore &store, size_t i, Object &sphere)
+  {
+    store.getSphere(i, sphere);
+  }
+
+  static void transform(Object &sphere, const double pose[4])
+  {
+    transformPoint(pose, sphere.bottom[0], sphere.bottom[1]);
+    sphere.bottom[2] += pose[2];
+  }
+
+  struct Shape
+  {
+    double center[3];
+    double radius, radiusSquared;
+    double min[3], max[3];
+  };
+
+  static void getShape(const Columns &spheres, size_t i, const double offset[3], Shape &sphere)
+  {
+    const double centerX = spheres.centerX[i] + offset[0];
+    const double centerY = spheres.centerY[i] + offset[1];
+    const double bottomZ = spheres.bottomZ[i] + offset[2];
+    sphere.radius = spheres.radius[i];
+    sphere.radiusSquared = sphere.radius * sphere.radius;
+    sphere.center[0] = centerX;
+    sphere.center[1] = centerY;
+    sphere.center[2] = bottomZ + sphere.radius;
+    sphere.min[0] = centerX - sphere.radius;
+    sphere.max[0] = centerX + sphere.radius;
+    sphere.min[1] = centerY - sphere.radius;
+    sphere.max[1] = centerY + sphere.radius;
+    sphere.min[2] = bottomZ;
+    sphere.max[2] = bottomZ + 2.0 * sphere.radius;
+  }
+
+  static void getRowSpans(const Shape &sphere, double x, std::vector<double> &spans)
+  {
+    double halfLength;
+    if (getChordHalfLength(x - sphere.center[0], sphere.radius, halfLength))
+      addSpan(std::max(sphere.min[1], sphere.center[1] - halfLength), std::min(sphere.max[1], sphere.center[1] + halfLength), spans);
+  }
+
+  static bool getColumnSpan(const Shape &sphere, double x, double y, double &zBegin, double &zEnd)
+  {
+    const double dx = x - sphere.center[0];
+    const double dy = y - sphere.center[1];
+    const double distanceSquared = dx * dx + dy * dy;
+    if (distanceSquared > sphere.radiusSquared)
+      return false;
+
+    const double halfHeight = sqrt(sphere.radiusSquared - distanceSquared);
+    zBegin = sphere.center[2] - halfHeight;
+    zEnd = sphere.center[2] + halfHeight;
+    return true;
+  }
+
+  static bool intersectRay(const Shape &sphere, const double origin[3], const double direction[3], double &t)
+  {
+    return intersectSphere(sphere.center, sphere.radiusSquared, origin, direction, t);
+  }
+
+  static double getVolume(const Columns &spheres, size_t i)
+  {
+    return 4.0 / 3.0 * M_PI * std::pow(static_cast<double>(spheres.radius[i]), 3);
+  }
+
+  static void getAnchor(const Columns &spheres, size_t i, double anchor[2])
+  {
+    anchor[0] = spheres.centerX[i];
+    anchor[1] = spheres.centerY[i];
+  }
+
+  static void getGazeboGeometries(const Columns &spheres, size_t i, std::vector<GazeboGeometry> &geometries)
+  {
+    const double radius = spheres.radius[i];
+    GazeboGeometry geometry;
+    geometry.pose = formatPose(spheres.centerX[i], spheres.centerY[i], spheres.bottomZ[i] + radius, 0.0, 0.0, 0.0);
+    geometry.type = "sphere";
+    geometry.parameters.push_back(std::make_pair(std::string("radius"), formatValues(&radius, 1)));
+    geometries.push_back(geometry);
+  }
+};
+
+struct CylinderKernel : ShapeKernelBase
+{
+  typedef ObjectCylinder Object;
+  typedef CylinderColumns Columns;
+
+  enum
+  {
+    FIELD_NAME = 1, FIELD_BOTTOM = 2, FIELD_RADIUS = 4, FIELD_HEIGHT = 8, FIELDS = 15
+  };
+
+  static unsigned int readField(const std::string &key, const std::string &value, Object &cylinder)
+  {
+    if (key == "name")
+    {
+      cylinder.name = value;
+      return FIELD_NAME;
+    }
+    else if (key == "bottom")
+      return parseValues(value, cylinder.bottom, 3) ? FIELD_BOTTOM : 0;
+    else if (key == "radius")
+      return parseValues(value, &cylinder.radius, 1) ? FIELD_RADIUS : 0;
+    else if (key == "height")
+      return parseValues(value, &cylinder.height, 1) ? FIELD_HEIGHT : 0;
+    return 0;
+  }
+
+  static const Columns& getColumns(const PrimitiveStore &store)
+  {
+    return store.cylinders;
+  }
+
+  static void add(PrimitiveStore &store, const Object &cylinder)
+  {
+    store.addCylinder(cylinder);
+  }
+
+  static void getObject(const PrimitiveStore &store, size_t i, Object &cylinder)
+  {
+    store.getCylinder(i, cylinder);
+  }
+
+  static void transform(Object &cylinder, const double pose[4])
+  {
+    transformPoint(pose, cylinder.bottom[0], cylinder.bottom[1]);
+    cylinder.bottom[2] += pose[2];
+  }
+
+  struct Shape
+  {
+    double center[2];
+    double radius, radiusSquared;
+    double min[3], max[3];
+  };
+
+  static void getShape(const Columns &cylinders, size_t i, const double offset[3], Shape &cylinder)
+  {
+    const double centerX = cylinders.centerX[i] + offset[0];
+    const double centerY = cylinders.centerY[i] + offset[1];
+    const double bottomZ = cylinders.bottomZ[i] + offset[2];
+    cylinder.radius = cylinders.radius[i];
+    cylinder.radiusSquared = cylinder.radius * cylinder.radius;
+    cylinder.center[0] = centerX;
+    cylinder.center[1] = centerY;
+    cylinder.min[0] = centerX - cylinder.radius;
+    cylinder.max[0] = centerX + cylinder.radius;
+    cylinder.min[1] = centerY - cylinder.radius;
+    cylinder.max[1] = centerY + cylinder.radius;
+    cylinder.min[2] = bottomZ;
+    cylinder.max[2] = bottomZ + cylinders.height[i];
+  }
+
+  static void getRowSpans(const Shape &cylinder, double x, std::vector<double> &spans)
+  {
+    double halfLength;
+    if (getChordHalfLength(x - cylinder.center[0], cylinder.radius, halfLength))
+      addSpan(std::max(cylinder.min[1], cylinder.center[1] - halfLength), std::min(cylinder.max[1], cylinder.center[1] + halfLength), spans);
+  }
+
+  static bool getColumnSpan(const Shape &cylinder, double x, double y, double &zBegin, double &zEnd)
+  {
+    const double dx = x - cylinder.center[0];
+    const double dy = y - cylinder.center[1];
+    if (dx * dx + dy * dy > cylinder.radiusSquared)
+      return false;
+
+    zBegin = cylinder.min[2];
+    zEnd = cylinder.max[2];
+    return true;
+  }
+
+  static bool intersectRay(const Shape &cylinder, const double origin[3], const double direction[3], double &t)
+  {
+    const double dx = origin[0] - cylinder.center[0], dy = origin[1] - cylinder.center[1];
+    double begin = 0.0, end = t;
+    clipQuadraticSpan(direction[0] * direction[0] + direction[1] * direction[1], 2.0 * (dx * direction[0] + dy * direction[1]),
+                      dx * dx + dy * dy - cylinder.radiusSquared, begin, end);
+    clipLinearSpan(origin[2], direction[2], cylinder.min[2], cylinder.max[2], begin, end);
+    return acceptRaySpan(begin, end, t);
+  }
+
+  static double getVolume(const Columns &cylinders, size_t i)
+  {
+    return M_PI * cylinders.radius[i] * cylinders.radius[i] * cylinders.height[i];
+  }
+
+  static void getAnchor(const Columns &cylinders, size_t i, double anchor[2])
+  {
+    anchor[0] = cylinders.centerX[i];
+    anchor[1] = cylinders.centerY[i];
+  }
+
+  static void getGazeboGeometries(const Columns &cylinders, size_t i, std::vector<GazeboGeometry> &geometries)
+  {
+    const double radius = cylinders.radius[i], height = cylinders.height[i];
+    GazeboGeometry geometry;
+    geometry.pose = formatPose(cylinders.centerX[i], cylinders.centerY[i], cylinders.bottomZ[i] + 0.5 * height, 0.0, 0.0, 0.0);
+    geometry.type = "cylinder";
+    geometry.parameters.push_back(std::make_pair(std::string("radius"), formatValues(&radius, 1)));
+    geometry.parameters.push_back(std::make_pair(std::string("length"), formatValues(&height, 1)));
+    geometries.push_back(geometry);
+  }
+};
+
+struct PolygonPrismKernel : ShapeKernelBase
+{
+  typedef ObjectPolygonPrism Object;
+  typedef PolygonPrismColumns Columns;
+
+  enum
+  {
+    FIELD_NAME = 1, FIELD_POINTS = 2, FIELD_BOTTOM = 4, FIELD_HEIGHT = 8, FIELDS = 15
+  };
+
+  static unsigned int readField(const std::string &key, const std::string &value, Object &polygonPrism)
+  {
+    if (key == "name")
+    {
+      polygonPrism.name = value;
+      return FIELD_NAME;
+    }
+    else if (key == "points")
+    {
+      polygonPrism.points.clear();
+      std::istringstream iss(value);
+      double coordinate;
+      while (iss >> coordinate)
+        polygonPrism.points.push_back(coordinate);
+      return polygonPrism.points.size() >= 6 && polygonPrism.points.size() % 2 == 0 ? FIELD_POINTS : 0;
+    }
+    else if (key == "bottom")
+      return parseValues(value, &polygonPrism.bottom, 1) ? FIELD_BOTTOM : 0;
+    else if (key == "height")
+      return parseValues(value, &polygonPrism.height, 1) ? FIELD_HEIGHT : 0;
+    return 0;
+  }
+
+  static const Columns& getColumns(const PrimitiveStore &store)
+  {
+    return store.polygonPrisms;
+  }
+
+  static void add(PrimitiveStore &store, const Object &polygonPrism)
+  {
+    store.addPolygonPrism(polygonPrism);
+  }
+
+  static void getObject(const PrimitiveStore &store, size_t i, Object &polygonPrism)
+  {
+    store.getPolygonPrism(i, polygonPrism);
+  }
+
+  static void transform(Object &polygonPrism, const double pose[4])
+  {
+    for (size_t p = 0; p + 1 < polygonPrism.points.size(); p += 2)
+      transformPoint(pose, polygonPrism.points[p], polygonPrism.points[p + 1]);
+    polygonPrism.bottom += pose[2];
+  }
+
+  struct Shape
+  {
+    const PrimitiveScalar *x, *y;
+    unsigned int numVertices;
+    double offset[2];
+    double min[3], max[3];
+  };
+
+  static void getShape(const Columns &polygonPrisms, size_t i, const double offset[3], Shape &polygon)
+  {
+    const unsigned int first = polygonPrisms.firstVertex[i];
+    polygon.x = &polygonPrisms.vertexX[first];
+    polygon.y = &polygonPrisms.vertexY[first];
+    polygon.numVertices = polygonPrisms.numVertices[i];
+    polygon.offset[0] = offset[0];
+    polygon.offset[1] = offset[1];
+
+    polygon.min[0] = polygon.max[0] = polygon.x[0] + offset[0];
+    polygon.min[1] = polygon.max[1] = polygon.y[0] + offset[1];
+    for (unsigned int v = 1; v < polygon.numVertices; ++v)
+    {
+      polygon.min[0] = std::min(polygon.min[0], polygon.x[v] + offset[0]);
+      polygon.max[0] = std::max(polygon.max[0], polygon.x[v] + offset[0]);
+      polygon.min[1] = std::min(polygon.min[1], polygon.y[v] + offset[1]);
+      polygon.max[1] = std::max(polygon.max[1], polygon.y[v] + offset[1]);
+    }
+    polygon.min[2] = polygonPrisms.bottomZ[i] + offset[2];
+    polygon.max[2] = polygon.min[2] + polygonPrisms.height[i];
+  }
+
+  static void getRowSpans(const Shape &polygon, double x, std::vector<double> &spans)
+  {
+    //scanline fill with the even-odd rule: the crossings of the row with the edges, sorted in y, pair up into spans
+    const size_t first = spans.size();
+    for (unsigned int i = 0, j = polygon.numVertices - 1; i < polygon.numVertices; j = i++)
+    {
+      const double xi = polygon.x[i] + polygon.offset[0], xj = polygon.x[j] + polygon.offset[0];
+      if ((xi <= x) == (xj <= x))
+        continue;
+
+      const double yi = polygon.y[i] + polygon.offset[1], yj = polygon.y[j] + polygon.offset[1];
+      spans.push_back(yi + (x - xi) * (yj - yi) / (xj - xi));
+    }
+    std::sort(spans.begin() + first, spans.end());
+  }
+
+  static bool getColumnSpan(const Shape &polygon, double, double, double &zBegin, double &zEnd)
+  {
+    //the row spans are exact, so every voxel they cover is inside
+    zBegin = polygon.min[2];
+    zEnd = polygon.max[2];
+    return true;
+  }
+
+  static bool intersectRay(const Shape &polygon, const double origin[3], const double direction[3], double &t)
+  {
+    double begin = 0.0, end = t;
+    clipLinearSpan(origin[2], direction[2], polygon.min[2], polygon.max[2], begin, end);
+    if (begin > end)
+      return false;
+
+    //a ray that is inside the polygon where it enters the z slab hits a cap (or starts inside);
+    //otherwise it enters through the first side it crosses within the slab
+    const double x = origin[0] + begin * direction[0] - polygon.offset[0], y = origin[1] + begin * direction[1] - polygon.offset[1];
+    bool inside = false;
+    for (unsigned int i = 0, j = polygon.numVertices - 1; i < polygon.numVertices; j = i++)
+    {
+      if ((polygon.y[i] <= y) != (polygon.y[j] <= y)
+          && x < polygon.x[i] + (y - polygon.y[i]) * (polygon.x[j] - polygon.x[i]) / (polygon.y[j] - polygon.y[i]))
+        inside = !inside;
+    }
+    if (inside)
+      return acceptRaySpan(begin, end, t);
+
+    double entry = HUGE_VAL;
+    for (unsigned int i = 0, j = polygon.numVertices - 1; i < polygon.numVertices; j = i++)
+    {
+      //origin + s * direction = vertex j + u * (vertex i - vertex j), solved in the xy plane
+      const double ex = polygon.x[i] - polygon.x[j], ey = polygon.y[i] - polygon.y[j];
+      const double denominator = direction[0] * ey - direction[1] * ex;
+      if (std::abs(denominator) < 1e-12)
+        continue;
+
+      const double wx = polygon.x[j] + polygon.offset[0] - origin[0], wy = polygon.y[j] + polygon.offset[1] - origin[1];
+      const double s = (wx * ey - wy * ex) / denominator;
+      const double u = (wx * direction[1] - wy * direction[0]) / denominator;
+      if (u >= 0.0 && u <= 1.0 && s >= begin && s <= end)
+        entry = std::min(entry, s);
+    }
+    return acceptRaySpan(entry, end, t);
+  }
+
+  static double getVolume(const Columns &polygonPrisms, size_t i)
+  {
+    const PrimitiveScalar *x = &polygonPrisms.vertexX[polygonPrisms.firstVertex[i]];
+    const PrimitiveScalar *y = &polygonPrisms.vertexY[polygonPrisms.firstVertex[i]];
+    const unsigned int n = polygonPrisms.numVertices[i];
+
+    double area = 0.0;
+    for (unsigned int v = 0, w = n - 1; v < n; w = v++)
+      area += (static_cast<double>(x[w]) - x[v]) * (static_cast<double>(y[w]) + y[v]);
+    return 0.5 * std::abs(area) * polygonPrisms.height[i];
+  }
+
+  static void getAnchor(const Columns &polygonPrisms, size_t i, double anchor[2])
+  {
+    const unsigned int first = polygonPrisms.firstVertex[i];
+    anchor[0] = polygonPrisms.vertexX[first];
+    anchor[1] = polygonPrisms.vertexY[first];
+  }
+
+  static void getGazeboGeometries(const Columns &polygonPrisms, size_t i, std::vector<GazeboGeometry> &geometries)
+  {
+    GazeboGeometry geometry;
+    geometry.pose = formatPose(0.0, 0.0, polygonPrisms.bottomZ[i], 0.0, 0.0, 0.0);
+    geometry.type = "polyline";
+
+    const unsigned int first = polygonPrisms.firstVertex[i];
+    for (unsigned int v = first; v < first + polygonPrisms.numVertices[i]; ++v)
+    {
+      const double point[2] = {polygonPrisms.vertexX[v], polygonPrisms.vertexY[v]};
+      geometry.parameters.push_back(std::make_pair(std::string("point"), formatValues(point, 2)));
+    }
+    const double height = polygonPrisms.height[i];
+    geometry.parameters.push_back(std::make_pair(std::string("height"), formatValues(&height, 1)));
+    geometries.push_back(geometry);
+  }
+};
+
+struct CapsuleKernel : ShapeKernelBase
+{
+  typedef ObjectCapsule Object;
+  typedef CapsuleColumns Columns;
+
+  enum
+  {
+    FIELD_NAME = 1, FIELD_START = 2, FIELD_END = 4, FIELD_RADIUS = 8, FIELDS = 15
+  };
+
+  static unsigned int readField(const std::string &key, const std::string &value, Object &capsule)
+  {
+    if (key == "name")
+    {
+      capsule.name = value;
+      return FIELD_NAME;
+    }
+    else if (key == "start")
+      return parseValues(value, capsule.start, 3) ? FIELD_START : 0;
+    else if (key == "end")
+      return parseValues(value, capsule.end, 3) ? FIELD_END : 0;
+    else if (key == "radius")
+      return parseValues(value, &capsule.radius, 1) ? FIELD_RADIUS : 0;
+    return 0;
+  }
+
+  static const Columns& getColumns(const PrimitiveStore &store)
+  {
+    return store.capsules;
+  }
+
+  static void add(PrimitiveStore &store, const Object &capsule)
+  {
+    store.addCapsule(capsule);
+  }
+
+  static void getObject(const PrimitiveStore &store, size_t i, Object &capsule)
+  {
+    store.getCapsule(i, capsule);
+  }
+
+  static void transform(Object &capsule, const double pose[4])
+  {
+    transformPoint(pose, capsule.start[0], capsule.start[1]);
+    transformPoint(pose, capsule.end[0], capsule.end[1]);
+    capsule.start[2] += pose[2];
+    capsule.end[2] += pose[2];
+  }
+
+  struct Shape
+  {
+    double start[3], end[3];
+    double axis[3];
+    double length;
+    double radius, radiusSquared;
+    double min[3], max[3];
+  };
+
+  static void getShape(const Columns &capsules, size_t i, const double offset[3], Shape &capsule)
+  {
+    capsule.start[0] = capsules.startX[i] + offset[0];
+    capsule.start[1] = capsules.startY[i] + offset[1];
+    capsule.start[2] = capsules.startZ[i] + offset[2];
+    capsule.end[0] = capsules.endX[i] + offset[0];
+    capsule.end[1] = capsules.endY[i] + offset[1];
+    capsule.end[2] = capsules.endZ[i] + offset[2];
+    capsule.radius = capsules.radius[i];
+    capsule.radiusSquared = capsule.radius * capsule.radius;
+
+    capsule.length = 0.0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      capsule.axis[axis] = capsule.end[axis] - capsule.start[axis];
+      capsule.length += capsule.axis[axis] * capsule.axis[axis];
+      capsule.min[axis] = std::min(capsule.start[axis], capsule.end[axis]) - capsule.radius;
+      capsule.max[axis] = std::max(capsule.start[axis], capsule.end[axis]) + capsule.radius;
+    }
+    capsule.length = sqrt(capsule.length);
+    for (int axis = 0; axis < 3; ++axis)
+      capsule.axis[axis] = capsule.length > 0.0 ? capsule.axis[axis] / capsule.length : 0.0;
+  }
+
+  static void getRowSpans(const Shape &capsule, double x, std::vector<double> &spans)
+  {
+    //the footprint is the disc swept along the projected segment; being convex, its row is the hull
+    //of the rows of both end discs and of the band along the segment
+    double begin = capsule.max[1], end = capsule.min[1], halfLength;
+    if (getChordHalfLength(x - capsule.start[0], capsule.radius, halfLength))
+    {
+      begin = std::min(begin, capsule.start[1] - halfLength);
+      end = std::max(end, capsule.start[1] + halfLength);
+    }
+    if (getChordHalfLength(x - capsule.end[0], capsule.radius, halfLength))
+    {
+      begin = std::min(begin, capsule.end[1] - halfLength);
+      end = std::max(end, capsule.end[1] + halfLength);
+    }
+
+    const double direction[2] = {capsule.end[0] - capsule.start[0], capsule.end[1] - capsule.start[1]};
+    const double projectedLength = sqrt(direction[0] * direction[0] + direction[1] * direction[1]);
+    if (projectedLength > 1e-12)
+    {
+      const double u[2] = {direction[0] / projectedLength, direction[1] / projectedLength};
+      const double dx = x - capsule.start[0];
+      double bandBegin = capsule.min[1], bandEnd = capsule.max[1];
+      clipLinearSpan(-u[1] * dx - u[0] * capsule.start[1], u[0], -capsule.radius, capsule.radius, bandBegin, bandEnd);
+      clipLinearSpan(u[0] * dx - u[1] * capsule.start[1], u[1], 0.0, projectedLength, bandBegin, bandEnd);
+      if (bandBegin <= bandEnd)
+      {
+        begin = std::min(begin, bandBegin);
+        end = std::max(end, bandEnd);
+      }
+    }
+
+    addSpan(std::max(begin, capsule.min[1]), std::min(end, capsule.max[1]), spans);
+  }
+
+  static bool getColumnSpan(const Shape &capsule, double x, double y, double &zBegin, double &zEnd)
+  {
+    //the vertical line through (x, y) meets the convex capsule in one interval, which is the hull of
+    //its intersections with both end spheres and with the cylinder between them
+    zBegin = HUGE_VAL;
+    zEnd = -HUGE_VAL;
+    addSphereSpan(capsule.start, capsule.radiusSquared, x, y, zBegin, zEnd);
+    addSphereSpan(capsule.end, capsule.radiusSquared, x, y, zBegin, zEnd);
+
+    if (capsule.length > 0.0)
+    {
+      //points (x, y, start z + c) have the axial coordinate t0 + c * axis z and the squared distance
+      //a * c^2 + b * c + d - radius^2 from the axis
+      const double wx = x - capsule.start[0], wy = y - capsule.start[1];
+      const double t0 = wx * capsule.axis[0] + wy * capsule.axis[1];
+      const double a = 1.0 - capsule.axis[2] * capsule.axis[2];
+      const double b = -2.0 * capsule.axis[2] * t0;
+      const double c = wx * wx + wy * wy - t0 * t0 - capsule.radiusSquared;
+
+      double begin = -HUGE_VAL, end = HUGE_VAL;
+      bool hit = true;
+      if (a < 1e-12)
+        hit = c <= 0.0;
+      else
+      {
+        const double discriminant = b * b - 4.0 * a * c;
+        hit = discriminant >= 0.0;
+        if (hit)
+        {
+          begin = (-b - sqrt(discriminant)) / (2.0 * a);
+          end = (-b + sqrt(discriminant)) / (2.0 * a);
+        }
+      }
+
+      if (std::abs(capsule.axis[2]) > 1e-12)
+      {
+        double c0 = -t0 / capsule.axis[2], c1 = (capsule.length - t0) / capsule.axis[2];
+        if (c0 > c1)
+          std::swap(c0, c1);
+        begin = std::max(begin, c0);
+        end = std::min(end, c1);
+      }
+      else if (t0 < 0.0 || t0 > capsule.length)
+        hit = false;
+
+      if (hit && begin <= end)
+      {
+        zBegin = std::min(zBegin, capsule.start[2] + begin);
+        zEnd = std::max(zEnd, capsule.start[2] + end);
+      }
+    }
+
+    return zBegin <= zEnd;
+  }
+
+  static void addSphereSpan(const double center[3], double radiusSquared, double x, double y, double &zBegin, double &zEnd)
+  {
+    const double distanceSquared = (x - center[0]) * (x - center[0]) + (y - center[1]) * (y - center[1]);
+    if (distanceSquared > radiusSquared)
+      return;
+
+    const double halfHeight = sqrt(radiusSquared - distanceSquared);
+    zBegin = std::min(zBegin, center[2] - halfHeight);
+    zEnd = std::max(zEnd, center[2] + halfHeight);
+  }
+
+  static bool intersectRay(const Shape &capsule, const double origin[3], const double direction[3], double &t)
+  {
+    //the first entry into the union of both end spheres and the cylinder between them
+    bool hit = intersectSphere(capsule.start, capsule.radiusSquared, origin, direction, t);
+    hit = intersectSphere(capsule.end, capsule.radiusSquared, origin, direction, t) || hit;
+    if (capsule.length <= 0.0)
+      return hit;
+
+    //radial part of the ray relative to the axis
+    const double w[3] = {origin[0] - capsule.start[0], origin[1] - capsule.start[1], origin[2] - capsule.start[2]};
+    const double wAxial = dot(w, capsule.axis), directionAxial = dot(direction, capsule.axis);
+    double wRadial[3], directionRadial[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      wRadial[axis] = w[axis] - wAxial * capsule.axis[axis];
+      directionRadial[axis] = direction[axis] - directionAxial * capsule.axis[axis];
+    }
+
+    double begin = 0.0, end = t;
+    clipQuadraticSpan(dot(directionRadial, directionRadial), 2.0 * dot(wRadial, directionRadial), dot(wRadial, wRadial) - capsule.radiusSquared, begin,
+                      end);
+    clipLinearSpan(wAxial, directionAxial, 0.0, capsule.length, begin, end);
+    return acceptRaySpan(begin, end, t) || hit;
+  }
+
+  static double getVolume(const Columns &capsules, size_t i)
+  {
+    const double dx = capsules.endX[i] - capsules.startX[i], dy = capsules.endY[i] - capsules.startY[i], dz = capsules.endZ[i] - capsules.startZ[i];
+    const double radius = capsules.radius[i];
+    return M_PI * radius * radius * (sqrt(dx * dx + dy * dy + dz * dz) + 4.0 / 3.0 * radius);
+  }
+
+  static void getAnchor(const Columns &capsules, size_t i, double anchor[2])
+  {
+    anchor[0] = 0.5 * (capsules.startX[i] + capsules.endX[i]);
+    anchor[1] = 0.5 * (capsules.startY[i] + capsules.endY[i]);
+  }
+
+  static void getGazeboGeometries(const Columns &capsules, size_t i, std::vector<GazeboGeometry> &geometries)
+  {
+    //sdf 1.5 has no capsule, so it is written as a cylinder with a sphere at each end
+    const double radius = capsules.radius[i];
+    const double start[3] = {capsules.startX[i], capsules.startY[i], capsules.startZ[i]};
+    const double end[3] = {capsules.endX[i], capsules.endY[i], capsules.endZ[i]};
+    const double axis[3] = {end[0] - start[0], end[1] - start[1], end[2] - start[2]};
+    const double length = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+    GazeboGeometry sphere;
+    sphere.type = "sphere";
+    sphere.parameters.push_back(std::make_pair(std::string("radius"), formatValues(&radius, 1)));
+    sphere.pose = formatPose(start[0], start[1], start[2], 0.0, 0.0, 0.0);
+    geometries.push_back(sphere);
+    sphere.pose = formatPose(end[0], end[1], end[2], 0.0, 0.0, 0.0);
+    geometries.push_back(sphere);
+
+    if (length > 0.0)
+    {
+      //the cylinder's z axis is pitched onto the capsule axis, then yawed around z
+      GazeboGeometry cylinder;
+      cylinder.pose = formatPose(0.5 * (start[0] + end[0]), 0.5 * (start[1] + end[1]), 0.5 * (start[2] + end[2]), 0.0,
+                                 atan2(sqrt(axis[0] * axis[0] + axis[1] * axis[1]), axis[2]), atan2(axis[1], axis[0]));
+      cylinder.type = "cylinder";
+      cylinder.parameters.push_back(std::make_pair(std::string("radius"), formatValues(&radius, 1)));
+      cylinder.parameters.push_back(std::make_pair(std::string("length"), formatValues(&length, 1)));
+      geometries.push_back(cylinder);
+    }
+  }
+};
+
+#endif // SIMPLE_WORLD_CREATOR_SHAPE_KERNELS_H_
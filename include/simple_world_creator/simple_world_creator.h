@@ -11,94 +11,177 @@
 #include <fstream>
 #include <iostream>
 #include <cstdio>
+#include <sys/stat.h>
+#include <chrono>
+#include <map>
+#include <algorithm>
+#include <iomanip>
+#include <limits>
 
 #include <octomap/octomap.h>
 
-struct ObjectBox
+#include <simple_world_creator/primitive_store.h>
+#include <simple_world_creator/shape_kernels.h>
+#include <simple_world_creator/column_world.h>
+#include <simple_world_creator/bulk_octree.h>
+#include <simple_world_creator/mesh_exporter.h>
+#include <simple_world_creator/voxelization_queue.h>
+#include <simple_world_creator/scan_simulator.h>
+#include <simple_world_creator/animation_delta.h>
+#include <simple_world_creator/query_server.h>
+#include <simple_world_creator/compressed_file.h>
+
+//named group of primitives that is placed into the world by instances
+struct ObjectPrototype
 {
   std::string name;
-  double bottomCenter[3];
-  double size[3];
-  double angle;
+  PrimitiveStore primitives;
 };
 
-struct ObjectLineBox
+struct ObjectInstance
 {
   std::string name;
-  double start[2];
-  double end[2];
-  double thickness;
-  double height[2];
+  int prototype;
+  double offset[3];
 };
 
-struct ObjectSphere
+//prototype moving through keyframes, poses in between are interpolated linearly
+struct ObjectAnimation
 {
   std::string name;
-  double bottom[3];
-  double radius;
-};
-
-struct ObjectCylinder
-{
-  std::string name;
-  double bottom[3];
-  double height, radius;
+  int prototype;
+  std::vector<double> keyframes; //time x y z yaw per keyframe, sorted by time, yaw in radians
 };
 
 class WorldCreator
 {
 public:
-  std::string fileName;
-  bool foundConfig;
-  bool canCreateGazebo;
-  bool canCreateOctomap;
-  bool canCreatePNG;
-
-  std::vector<ObjectBox> boxes;
-  std::vector<ObjectSphere> spheres;
-  std::vector<ObjectCylinder> cylinders;
-  bool addFloor;
-  std::string worldName;
-  double resolution;
-  double updateRate;
-  double minX, minY, minZ, maxX, maxY, maxZ;
-
-  octomap::OcTree* octree;
+  WorldCreator(std::string file);
+  ~WorldCreator();
 
-  std::vector<std::vector<bool> > occupancyMap;
+  bool hasFoundConfig() const;
+  void swapColumns(ColumnWorld &scratch);
+  //worker threads of the parallel outputs such as scans, 0 uses all cores
+  void setNumThreads(int numThreads);
 
-  WorldCreator(std::string file);
+  //creates all outputs requested by the command line options ('--octomap', '--gazebo', ...)
+  bool createWorldFiles(const std::vector<std::string> &options, bool verbose);
 
   //methods for reading world config file
   bool readConfigFile();
+  void reservePrimitives(std::ifstream &file);
+  PrimitiveStore& getTargetPrimitives();
   void setCreatePossibilities();
 
   void getKeyValuePair(std::string &str, std::pair<std::string, std::string> &keyValuePair);
-  void readBox(std::ifstream &file);
-  void readLineBox(std::ifstream &file);
-  void readSphere(std::ifstream &file);
-  void readCylinder(std::ifstream &file);
-  void convertLineBoxToBox(const ObjectLineBox &lineBox, ObjectBox &box);
+  template<typename Kernel>
+  void readShape(std::ifstream &file);
+  void readPrototype(std::ifstream &file);
+  void readInstance(std::ifstream &file);
+  void readArray(std::ifstream &file);
+  void readScan(std::ifstream &file);
+  void readAnimation(std::ifstream &file);
+  int findPrototype(const std::string &name) const;
 
   //methods for creating gazebo world file
-  bool createGazeboWorldFile();
-  void addGazeboHead(std::ofstream &file);
-  void addGazeboTail(std::ofstream &file);
-  void addGazeboBox(std::ofstream &file, ObjectBox &box);
-  void addGazeboSphere(std::ofstream &file, ObjectSphere &sphere);
-  void addGazeboCylinder(std::ofstream &file, ObjectCylinder &cylinder);
+  bool createGazeboWorldFile(bool batched = false);
+  void addGazeboHead(std::ostream &file);
+  void addGazeboTail(std::ostream &file);
+  template<typename Kernel>
+  void addGazeboShapes(std::ostream &file, const PrimitiveStore &gazeboPrimitives);
+  void addGazeboModel(std::ostream &file, const std::string &name, const std::vector<GazeboGeometry> &geometries);
+  void mergeCollinearBoxes(const PrimitiveStore &input, PrimitiveStore &output);
+
+  //methods for creating gazebo world file with primitives batched into few static models
+  void addGazeboBatches(std::ostream &file, const PrimitiveStore &gazeboPrimitives);
+  template<typename Kernel>
+  void addGazeboBatchShape(std::ostream &file, const PrimitiveStore &gazeboPrimitives, size_t i, int &id);
+  void addGazeboBatchElement(std::ostream &file, const std::string &name, int id, const std::string &pose, const std::string &geometry);
+
+  //methods for creating gazebo models shared by all instances of a prototype
+  bool createGazeboPrototypeModels();
+  void addGazeboInstance(std::ostream &file, const ObjectInstance &instance);
+
+  //methods for creating the column world all other outputs are generated from
+  bool createColumnWorld();
+  void reserveDenseColumns();
+  bool getPrimitiveBounds(double min[3], double max[3]) const;
+  void queueFloor(VoxelizationQueue &queue, PrimitiveStore &floor);
+  bool getKeyOffset(const double offset[3], int keyOffset[3]) const;
+  void queueColumnInstances(VoxelizationQueue &queue, std::vector<ColumnWorld> &prototypeColumns);
 
   //methods for creating octomap world file
   bool createOctree();
-  void addOctreeBox(octomap::OcTree &octree, ObjectBox &box);
-  void addOctreeSphere(octomap::OcTree &octree, ObjectSphere &sphere);
-  void addOctreeCylinder(octomap::OcTree &octree, ObjectCylinder &cylinder);
+  bool buildOctree();
+
+  //methods for answering batched queries against the resident octree ('--serve')
+  bool serveQueries(int numThreads);
+
+  //methods for creating triangle mesh files
+  bool createMesh(bool obj);
 
   //methods for creating png image
   bool createPNG();
   void createOccupancyMapFromOctomap();
-  bool isOctreeNodeOccupied(const octomap::OcTreeKey &key) const;
   void writeDataToPNM(std::ofstream &file);
+
+  //methods for casting simulated sensor scans against the primitives
+  bool createScans();
+
+  //methods for creating a base octree and per-frame deltas of the animated objects
+  bool createAnimation();
+  bool voxelizeAnimatedPrototypes(std::vector<ColumnWorld> &prototypeColumns);
+  void getAnimationPose(const ObjectAnimation &animation, double time, double pose[4]) const;
+  bool addAnimatedObjects(double time, const std::vector<ColumnWorld> &prototypeColumns, ColumnWorld &frame);
+
+  //methods for writing output files, compressed on a background thread with '--compress=<zstd[:level]|lz4[:level]>'
+  bool openOutputFile(const std::string &name, CompressedOutputFile &file);
+  bool closeOutputFile(CompressedOutputFile &file);
+
+  //methods for reporting memory and timing
+  void printStats() const;
+
+private:
+  WorldCreator(const WorldCreator&);
+  WorldCreator& operator=(const WorldCreator&);
+
+  std::string fileName;
+  bool foundConfig;
+  bool canCreateGazebo;
+  bool canCreateOctomap;
+  bool canCreatePNG;
+
+  PrimitiveStore primitives;
+  std::vector<ObjectPrototype> prototypes;
+  std::vector<ObjectInstance> instances;
+  std::vector<ObjectScan> scans;
+  std::vector<ObjectAnimation> animations;
+  int currentPrototype;
+  bool addFloor;
+  bool mergeLineBoxes;
+  bool markFreeSpace;
+  double batchCellSize;
+  double voxelizeTimeBudget;
+  double denseGridMemoryLimit;
+  Compression compression;
+  int compressionLevel;
+  uint64_t uncompressedBytes, compressedBytes;
+  bool verbose;
+  int numThreads;
+  std::string worldName;
+  double resolution;
+  double updateRate;
+  double frameRate;
+  double minX, minY, minZ, maxX, maxY, maxZ;
+
+  ColumnWorld columns;
+  bool hasColumns;
+  octomap::OcTree* octree;
+
+  std::vector<std::vector<bool> > occupancyMap;
+
+  double parseSeconds;
+  double voxelizeSeconds;
 };
 
 #endif // SIMPLE_WORLD_CREATOR_SIMPLE_WORLD_CREATOR_H_
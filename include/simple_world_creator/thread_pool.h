@@ -0,0 +1,55 @@
+#ifndef SIMPLE_WORLD_CREATOR_THREAD_POOL_H_
+#define SIMPLE_WORLD_CREATOR_THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//Fixed set of worker threads with one job deque per worker. Workers take jobs from the
+//back of their own deque and steal from the front of the others once theirs is empty.
+//Jobs receive the index of the worker running them, so callers can keep per-worker scratch data.
+class ThreadPool
+{
+public:
+  typedef std::function<void(int worker)> Job;
+
+  explicit ThreadPool(int numThreads = 0);
+  ~ThreadPool();
+
+  int getNumThreads() const;
+
+  //runs all jobs and blocks until the last one has finished; must not be called from within a job
+  void run(std::vector<Job> &jobs);
+
+  //splits [0, size) into chunks of at most grainSize and runs them as jobs
+  void parallelFor(size_t size, size_t grainSize, const std::function<void(size_t begin, size_t end, int worker)> &function);
+
+private:
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  void workerLoop(int worker);
+  bool popJob(int worker, Job &job);
+
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<WorkQueue> > queues;
+
+  std::mutex stateMutex;
+  std::condition_variable workCondition;
+  std::condition_variable doneCondition;
+  size_t remainingJobs;
+  size_t generation;
+  bool stopping;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_THREAD_POOL_H_
@@ -0,0 +1,73 @@
+#ifndef SIMPLE_WORLD_CREATOR_VOXELIZATION_QUEUE_H_
+#define SIMPLE_WORLD_CREATOR_VOXELIZATION_QUEUE_H_
+
+#include <vector>
+#include <functional>
+
+#include <simple_world_creator/column_world.h>
+#include <simple_world_creator/primitive_store.h>
+
+struct VoxelizationProgress
+{
+  double voxelsDone;
+  double voxelsTotal;
+  double elapsedSeconds;
+  double remainingSeconds;
+};
+
+typedef std::function<void(const VoxelizationProgress &progress)> VoxelizationProgressCallback;
+
+//Splits the rasterization of primitive sets into jobs of bounded size and runs them in order,
+//together with any other queued tasks.
+//Small primitives are grouped into one job, large ones are cut into slabs of x keys. Between
+//jobs the queue reports progress against the analytic volume of all queued primitives and
+//stops on ROS shutdown or once the time budget is used up.
+class VoxelizationQueue
+{
+public:
+  VoxelizationQueue();
+
+  void setProgressCallback(const VoxelizationProgressCallback &callback);
+  void setTimeBudget(double seconds);
+  void setMaxVoxelsPerJob(double voxels);
+
+  void addPrimitives(ColumnWorld &target, const PrimitiveStore &primitives, const double offset[3]);
+  //other work on the voxel worlds, e.g. stamping an instance, that counts as estimatedVoxels for the progress
+  void addTask(const std::function<void()> &task, double estimatedVoxels);
+
+  //returns false if the run was cancelled; the targets then hold partial results
+  bool run();
+  bool isTimeBudgetExceeded() const;
+  double getEstimatedVoxels() const;
+
+private:
+  typedef void (*RasterizeFunction)(ColumnWorld &target, const PrimitiveStore &primitives, size_t begin, size_t end, const double offset[3],
+                                    int slabBegin, int slabEnd);
+
+  struct Job
+  {
+    ColumnWorld *target;
+    const PrimitiveStore *primitives;
+    double offset[3];
+    RasterizeFunction rasterize;
+    size_t begin, end;
+    int slabBegin, slabEnd;
+    std::function<void()> task;
+    double estimatedVoxels;
+  };
+
+  template<typename Kernel>
+  void addJobs(ColumnWorld &target, const PrimitiveStore &primitives, const double offset[3]);
+  template<typename Kernel>
+  static void rasterize(ColumnWorld &target, const PrimitiveStore &primitives, size_t begin, size_t end, const double offset[3], int slabBegin,
+                        int slabEnd);
+
+  std::vector<Job> jobs;
+  VoxelizationProgressCallback progressCallback;
+  double timeBudget;
+  double maxVoxelsPerJob;
+  double estimatedVoxels;
+  bool timeBudgetExceeded;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_VOXELIZATION_QUEUE_H_
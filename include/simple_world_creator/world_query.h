@@ -0,0 +1,62 @@
+#ifndef SIMPLE_WORLD_CREATOR_WORLD_QUERY_H_
+#define SIMPLE_WORLD_CREATOR_WORLD_QUERY_H_
+
+#include <stdint.h>
+
+#include <octomap/octomap.h>
+
+#include <simple_world_creator/thread_pool.h>
+
+//Answers batched occupancy, box, ray and obstacle distance queries against an octree that stays
+//resident. Every query descends from the root and stops at the first node that decides it: pruned
+//leaves are uniform over their whole cube, and inner nodes hold the maximum of their children (as
+//written by BulkOcTree and octomap's updateInnerOccupancy()), so a free inner node rules out its
+//whole cube at once. Batches are spread over a thread pool; the tree must not change while queried.
+class WorldQuery
+{
+public:
+  enum
+  {
+    STATE_UNKNOWN = -1, STATE_FREE = 0, STATE_OCCUPIED = 1
+  };
+
+  WorldQuery(const octomap::OcTree &octree, int numThreads = 0);
+
+  //batches, n queries each: points are x y z, boxes min x y z max x y z, rays origin x y z direction x y z
+  void queryPoints(const double *points, size_t n, int8_t *states);
+  void queryBoxes(const double *boxes, size_t n, uint8_t *occupied);
+  //ranges receive the metric distance to the first occupied voxel, or NaN if there is none within maxRange
+  void castRays(const double *rays, size_t n, double maxRange, float *ranges);
+  //distances receive the distance to the closest occupied voxel, capped at maxDistance
+  void queryDistances(const double *points, size_t n, double maxDistance, float *distances);
+
+  //single queries, these may be called from several threads at once
+  int getState(const double point[3]) const;
+  bool isBoxOccupied(const double min[3], const double max[3]) const;
+  double castRay(const double origin[3], const double direction[3], double maxRange) const;
+  double getDistance(const double point[3], double maxDistance) const;
+
+private:
+  //node with the metric lower corner and edge length of its cube
+  struct Cube
+  {
+    octomap::OcTreeNode *node;
+    double min[3];
+    double size;
+  };
+
+  static const size_t GRAIN_SIZE = 256;
+
+  void getChild(const Cube &cube, unsigned int i, Cube &child) const;
+  //true if the cube holds no occupied voxel
+  bool isCubeFree(const Cube &cube) const;
+  bool isBoxOccupied(const Cube &cube, const double min[3], const double max[3]) const;
+  void castRay(const Cube &cube, const double origin[3], const double inverseDirection[3], unsigned int childMask, double &t) const;
+  void getDistanceSquared(const Cube &cube, const double point[3], double &distanceSquared) const;
+
+  const octomap::OcTree &octree;
+  ThreadPool pool;
+  Cube root;
+};
+
+#endif // SIMPLE_WORLD_CREATOR_WORLD_QUERY_H_
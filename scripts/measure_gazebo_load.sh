@@ -0,0 +1,34 @@
+#!/bin/bash
+#Times how long gzserver takes to load a world written with '--gazebo' and with '--gazebo_batched'.
+#gzserver only simulates a single iteration and exits, so the time is dominated by loading the world.
+#Usage: measure_gazebo_load.sh <world config> [runs]
+
+if [ -z "$1" ]; then
+  echo "Usage: measure_gazebo_load.sh <world config> [runs]"
+  exit 1
+fi
+
+config=$(readlink -f "$1")
+runs=${2:-5}
+directory=$(mktemp -d)
+trap 'rm -rf "$directory"' EXIT
+
+cd "$directory" || exit 1
+cp "$config" world
+for mode in gazebo gazebo_batched; do
+  rm -rf world.world world_models
+  if ! rosrun simple_world_creator simple_world_creator world --$mode > /dev/null; then
+    echo "Could not create the world with '--$mode'."
+    exit 1
+  fi
+
+  models=$(grep -c "<model name=\|<include>" world.world)
+  best=""
+  for ((run = 0; run < runs; ++run)); do
+    TIMEFORMAT=%R
+    seconds=$( { time GAZEBO_MODEL_PATH="$directory/world_models:$GAZEBO_MODEL_PATH" gzserver --iters 1 world.world > /dev/null 2>&1; } 2>&1)
+    best=$(awk -v seconds="$seconds" -v best="$best" 'BEGIN { print (best == "" || seconds < best) ? seconds : best }')
+  done
+
+  printf "%-16s %6d models  %7.2f s (best of %d)\n" "--$mode" "$models" "$best" "$runs"
+done
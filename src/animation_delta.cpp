@@ -0,0 +1,67 @@
+#include <simple_world_creator/animation_delta.h>
+
+#include <stdint.h>
+
+namespace
+{
+template<typename T>
+void writeValue(std::ostream &file, T value)
+{
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+}
+
+void AnimationDelta::compute(const ColumnWorld &previous, const ColumnWorld &current, const ColumnWorld &fixed)
+{
+  //the moving worlds are subtracted first, they are much smaller than the static one
+  scratch.subtract(current, previous);
+  added.subtract(scratch, fixed);
+  scratch.subtract(previous, current);
+  removed.subtract(scratch, fixed);
+}
+
+size_t AnimationDelta::getNumAddedRuns() const
+{
+  return added.getNumRuns();
+}
+
+size_t AnimationDelta::getNumRemovedRuns() const
+{
+  return removed.getNumRuns();
+}
+
+bool AnimationDelta::write(std::ostream &file, unsigned int frame, double time) const
+{
+  file.write("SWCDELT1", 8);
+  writeValue<uint32_t>(file, frame);
+  writeValue<double>(file, time);
+  writeValue<double>(file, added.getResolution());
+  writeValue<uint32_t>(file, getNumAddedRuns());
+  writeValue<uint32_t>(file, getNumRemovedRuns());
+  writeRuns(file, added);
+  writeRuns(file, removed);
+  return file.good();
+}
+
+void AnimationDelta::writeRuns(std::ostream &file, const ColumnWorld &world)
+{
+  if (world.empty())
+    return;
+
+  for (int x = world.getMinKey(0); x <= world.getMaxKey(0); ++x)
+  {
+    size_t column, columnsEnd;
+    world.getRowColumns(x, column, columnsEnd);
+    for (; column < columnsEnd; ++column)
+    {
+      const ZRun *run, *end;
+      world.getColumnRuns(column, run, end);
+      for (; run != end; ++run)
+      {
+        //an end at the top of the key range wraps to 0
+        const uint16_t keys[4] = {static_cast<uint16_t>(x), world.getColumnY(column), run->begin, static_cast<uint16_t>(run->end)};
+        file.write(reinterpret_cast<const char*>(keys), sizeof(keys));
+      }
+    }
+  }
+}
@@ -0,0 +1,192 @@
+#include <simple_world_creator/batch_runner.h>
+#include <simple_world_creator/compressed_file.h>
+#include <simple_world_creator/simple_world_creator.h>
+#include <simple_world_creator/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <glob.h>
+
+namespace
+{
+bool hasExtension(const std::string &name, const std::string &extension)
+{
+  return name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+BatchRunner::BatchRunner(const std::vector<std::string> &options, int numThreads) :
+    options(options), numThreads(numThreads), totalSeconds(0.0)
+{
+}
+
+bool BatchRunner::collectWorldFiles(const std::string &source)
+{
+  worldFiles.clear();
+
+  struct stat status;
+  if (source.find_first_of("*?[") != std::string::npos)
+    collectGlob(source);
+  else if (stat(source.c_str(), &status) != 0)
+  {
+    std::cout << "Batch source '" << source << "' does not exist." << std::endl;
+    return false;
+  }
+  else if (S_ISDIR(status.st_mode))
+    collectDirectory(source);
+  else
+    collectManifest(source);
+
+  std::sort(worldFiles.begin(), worldFiles.end());
+  worldFiles.erase(std::unique(worldFiles.begin(), worldFiles.end()), worldFiles.end());
+
+  if (worldFiles.empty())
+  {
+    std::cout << "No world files found in '" << source << "'." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool BatchRunner::run()
+{
+  ThreadPool pool(numThreads);
+  std::vector<ColumnWorld> scratch(pool.getNumThreads());
+  //worlds already run in parallel, so each one only gets its share of the threads for its own parallel outputs
+  const int threadsPerWorld = std::max<int>(1, pool.getNumThreads() / worldFiles.size());
+
+  results.assign(worldFiles.size(), BatchResult());
+
+  std::vector<ThreadPool::Job> jobs;
+  for (size_t i = 0; i < worldFiles.size(); ++i)
+  {
+    jobs.push_back([this, i, &scratch, threadsPerWorld](int worker)
+    {
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      BatchResult &result = results[i];
+      result.fileName = worldFiles[i];
+
+      WorldCreator worldCreator(worldFiles[i]);
+      if (worldCreator.hasFoundConfig())
+      {
+        worldCreator.setCreatePossibilities();
+        worldCreator.setNumThreads(threadsPerWorld);
+        worldCreator.swapColumns(scratch[worker]);
+        result.success = worldCreator.createWorldFiles(options, false);
+        worldCreator.swapColumns(scratch[worker]);
+      }
+      else
+        result.success = false;
+
+      result.seconds = secondsSince(start);
+    });
+  }
+
+  ROS_INFO("Creating %zu worlds on %d threads...", worldFiles.size(), pool.getNumThreads());
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  pool.run(jobs);
+  totalSeconds = secondsSince(start);
+
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    if (!results[i].success)
+      return false;
+  }
+  return true;
+}
+
+void BatchRunner::printReport() const
+{
+  int failed = 0;
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    printf("%-6s %9.3f s  %s\n", results[i].success ? "OK" : "FAILED", results[i].seconds, results[i].fileName.c_str());
+    if (!results[i].success)
+      ++failed;
+  }
+  printf("%zu worlds, %d failed, %.3f s total\n", results.size(), failed, totalSeconds);
+}
+
+bool BatchRunner::collectDirectory(const std::string &directory)
+{
+  DIR *dir = opendir(directory.c_str());
+  if (dir == NULL)
+    return false;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    const std::string name(entry->d_name);
+    if (name.empty() || name[0] == '.' || isOutputFile(name))
+      continue;
+
+    const std::string path = directory + "/" + name;
+    struct stat status;
+    if (stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode))
+      worldFiles.push_back(path);
+  }
+
+  closedir(dir);
+  return true;
+}
+
+bool BatchRunner::collectGlob(const std::string &pattern)
+{
+  glob_t matches;
+  if (glob(pattern.c_str(), 0, NULL, &matches) != 0)
+    return false;
+
+  for (size_t i = 0; i < matches.gl_pathc; ++i)
+  {
+    const std::string path(matches.gl_pathv[i]);
+    struct stat status;
+    if (!isOutputFile(path) && stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode))
+      worldFiles.push_back(path);
+  }
+
+  globfree(&matches);
+  return true;
+}
+
+bool BatchRunner::collectManifest(const std::string &manifest)
+{
+  std::ifstream file(manifest.c_str());
+  if (!file.good())
+    return false;
+
+  //relative entries are relative to the manifest itself
+  const size_t slash = manifest.rfind('/');
+  const std::string directory = slash == std::string::npos ? "" : manifest.substr(0, slash + 1);
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    worldFiles.push_back(line[0] == '/' ? line : directory + line);
+  }
+
+  return true;
+}
+
+bool BatchRunner::isOutputFile(const std::string &name)
+{
+  //compressed artifacts are told apart by the name below their compression suffix
+  const std::string plainName = CompressedInputFile::stripSuffix(name);
+  const char* extensions[] = {".bt", ".ot", ".world", ".png", ".pnm", ".stl", ".obj", ".scan", ".delta", ".zst", ".lz4"};
+  for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i)
+  {
+    if (hasExtension(name, extensions[i]) || hasExtension(plainName, extensions[i]))
+      return true;
+  }
+  return false;
+}
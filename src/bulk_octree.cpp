@@ -0,0 +1,158 @@
+#include <simple_world_creator/bulk_octree.h>
+
+#include <algorithm>
+
+BulkOcTree::BulkOcTree(double resolution) :
+    octomap::OcTree(resolution), occupiedLogOdds(0.0f), freeLogOdds(0.0f), markFree(false), dense(NULL)
+{
+  std::fill(freeMin, freeMin + 3, 0);
+  std::fill(freeMax, freeMax + 3, -1);
+}
+
+void BulkOcTree::insertColumns(const ColumnWorld &columns, bool markFree)
+{
+  //leaves get the value of one clamped hit or miss, as updateNode() gives a new node
+  occupiedLogOdds = std::min(getProbHitLog(), getClampingThresMaxLog());
+  freeLogOdds = std::max(getProbMissLog(), getClampingThresMinLog());
+
+  this->markFree = markFree && !columns.empty();
+  for (int axis = 0; axis < 3 && this->markFree; ++axis)
+  {
+    freeMin[axis] = columns.getMinKey(axis);
+    freeMax[axis] = columns.getMaxKey(axis);
+  }
+
+  //the cubes that contain a column are classified with increasing z, as the lower children of a
+  //cube are inserted first, so the run cursors only move up and every run is passed once
+  dense = columns.getDenseGrid();
+  if (!dense)
+  {
+    runCursors.resize(columns.getNumColumns());
+    for (size_t column = 0; column < runCursors.size(); ++column)
+    {
+      const ZRun *end;
+      columns.getColumnRuns(column, runCursors[column], end);
+    }
+  }
+
+  const CubeState state = getCubeState(columns, 0, 0, 0, ColumnWorld::KEY_LIMIT);
+  if (state != CUBE_UNKNOWN)
+  {
+    root = new octomap::OcTreeNode();
+    ++tree_size;
+    size_changed = true;
+    insertCube(root, state, columns, 0, 0, 0, ColumnWorld::KEY_LIMIT);
+  }
+
+  dense = NULL;
+  std::vector<const ZRun*>().swap(runCursors);
+}
+
+BulkOcTree::CubeState BulkOcTree::getCubeState(const ColumnWorld &columns, int x, int y, int z, int size)
+{
+  const CubeState occupancy = columns.empty() ? CUBE_UNKNOWN : getOccupancy(columns, x, y, z, size);
+  if (occupancy != CUBE_UNKNOWN || !markFree)
+    return occupancy;
+
+  //unoccupied cubes inside the free box become one coarse free leaf, cubes on its border are split
+  const int corner[3] = {x, y, z};
+  bool inside = true;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (corner[axis] > freeMax[axis] || corner[axis] + size - 1 < freeMin[axis])
+      return CUBE_UNKNOWN;
+    if (corner[axis] < freeMin[axis] || corner[axis] + size - 1 > freeMax[axis])
+      inside = false;
+  }
+  return inside ? CUBE_FREE : CUBE_MIXED;
+}
+
+BulkOcTree::CubeState BulkOcTree::getOccupancy(const ColumnWorld &columns, int x, int y, int z, int size)
+{
+  const int xBegin = std::max<int>(x, columns.getMinKey(0)), xEnd = std::min<int>(x + size - 1, columns.getMaxKey(0));
+  const int yBegin = std::max<int>(y, columns.getMinKey(1)), yEnd = std::min<int>(y + size - 1, columns.getMaxKey(1));
+  if (xBegin > xEnd || yBegin > yEnd)
+    return CUBE_UNKNOWN;
+
+  //columns outside the world rectangle are empty
+  bool empty = xEnd - xBegin + 1 < size || yEnd - yBegin + 1 < size;
+  bool occupied = false;
+
+  for (int i = xBegin; i <= xEnd && dense; ++i)
+  {
+    for (int j = yBegin; j <= yEnd; ++j)
+    {
+      bool any, all;
+      dense->getBandState(i, j, z, z + size, any, all);
+      if (!any)
+        empty = true;
+      else if (all)
+        occupied = true;
+      else
+        return CUBE_MIXED;
+
+      if (empty && occupied)
+        return CUBE_MIXED;
+    }
+  }
+
+  for (int i = xBegin; i <= xEnd && !dense; ++i)
+  {
+    //only non-empty columns are indexed, any that the row lacks are empty
+    size_t column, columnsEnd;
+    columns.getRowColumns(i, yBegin, yEnd + 1, column, columnsEnd);
+    if (columnsEnd - column < static_cast<size_t>(yEnd - yBegin + 1))
+      empty = true;
+    if (empty && occupied)
+      return CUBE_MIXED;
+
+    for (; column < columnsEnd; ++column)
+    {
+      const ZRun *begin, *end;
+      columns.getColumnRuns(column, begin, end);
+
+      //first run that ends above the cube bottom; runs are sorted and disjoint
+      const ZRun *&run = runCursors[column];
+      for (; run != end && run->end <= z; ++run)
+        ;
+
+      if (run == end || run->begin >= z + size)
+        empty = true;
+      else if (run->begin <= z && run->end >= z + size)
+        occupied = true;
+      else
+        return CUBE_MIXED;
+
+      if (empty && occupied)
+        return CUBE_MIXED;
+    }
+  }
+
+  return occupied ? CUBE_OCCUPIED : CUBE_UNKNOWN;
+}
+
+void BulkOcTree::insertCube(octomap::OcTreeNode *node, CubeState state, const ColumnWorld &columns, int x, int y, int z, int size)
+{
+  if (state == CUBE_OCCUPIED || state == CUBE_FREE)
+  {
+    node->setLogOdds(state == CUBE_OCCUPIED ? occupiedLogOdds : freeLogOdds);
+    return;
+  }
+
+  //mixed cube: children follow the octomap child index (bit 0 x, bit 1 y, bit 2 z), the
+  //inner node takes the maximum of its children like updateInnerOccupancy()
+  const int half = size / 2;
+  float logOdds = getClampingThresMinLog();
+  for (unsigned int i = 0; i < 8; ++i)
+  {
+    const int childX = x + ((i & 1) ? half : 0), childY = y + ((i & 2) ? half : 0), childZ = z + ((i & 4) ? half : 0);
+    const CubeState childState = getCubeState(columns, childX, childY, childZ, half);
+    if (childState == CUBE_UNKNOWN)
+      continue;
+
+    octomap::OcTreeNode *child = createNodeChild(node, i);
+    insertCube(child, childState, columns, childX, childY, childZ, half);
+    logOdds = std::max(logOdds, child->getLogOdds());
+  }
+  node->setLogOdds(logOdds);
+}
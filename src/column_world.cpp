@@ -0,0 +1,552 @@
+#include <simple_world_creator/column_world.h>
+#include <simple_world_creator/shape_kernels.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+//key of the voxel whose lower corner lies at the origin (octomap tree depth 16)
+const int KEY_CENTER = 32768;
+const int KEY_MAX = 65535;
+
+octomap::key_type clampKey(int key)
+{
+  return static_cast<octomap::key_type>(std::max(0, std::min(KEY_MAX, key)));
+}
+
+//exclusive end keys may lie one past the top key
+int clampEnd(int key)
+{
+  return std::max(0, std::min(KEY_MAX + 1, key));
+}
+}
+
+ColumnWorld::ColumnWorld()
+{
+  reset(0.1);
+}
+
+void ColumnWorld::reset(double res)
+{
+  resolution = res;
+  pending.clear();
+  runs.clear();
+  minKey[0] = minKey[1] = minKey[2] = 0;
+  maxKey[0] = maxKey[1] = maxKey[2] = 0;
+  size_t nextRow = 0;
+  clearIndex(0);
+  finishIndex(nextRow);
+  dense.clear();
+  denseComplete = denseDirty = false;
+}
+
+void ColumnWorld::swap(ColumnWorld &other)
+{
+  std::swap(resolution, other.resolution);
+  pending.swap(other.pending);
+  std::swap_ranges(minKey, minKey + 3, other.minKey);
+  std::swap_ranges(maxKey, maxKey + 3, other.maxKey);
+  rowOffsets.swap(other.rowOffsets);
+  columnKeys.swap(other.columnKeys);
+  columnOffsets.swap(other.columnOffsets);
+  runs.swap(other.runs);
+  dense.swap(other.dense);
+  std::swap(denseComplete, other.denseComplete);
+  std::swap(denseDirty, other.denseDirty);
+}
+
+void ColumnWorld::reserveDense(const octomap::key_type min[3], const octomap::key_type max[3])
+{
+  dense.reset(min, max);
+  denseComplete = pending.empty() && runs.empty();
+  denseDirty = false;
+}
+
+bool ColumnWorld::hasDenseGrid() const
+{
+  return dense.isAllocated();
+}
+
+void ColumnWorld::addRun(octomap::key_type x, octomap::key_type y, octomap::key_type zBegin, int zEnd)
+{
+  if (zBegin >= zEnd)
+    return;
+
+  if (dense.containsRun(x, y, zBegin, zEnd))
+  {
+    dense.setRun(x, y, zBegin, zEnd);
+    denseDirty = true;
+    return;
+  }
+  denseComplete = false;
+
+  PendingRun pendingRun;
+  pendingRun.x = x;
+  pendingRun.y = y;
+  pendingRun.run.begin = zBegin;
+  pendingRun.run.end = zEnd;
+  pending.push_back(pendingRun);
+}
+
+void ColumnWorld::addBox(double centerX, double centerY, double bottomZ, double sizeX, double sizeY, double sizeZ, double angle)
+{
+  BoxKernel::Shape box;
+  BoxKernel::getShape(centerX, centerY, bottomZ, sizeX, sizeY, sizeZ, angle, box);
+  addShape<BoxKernel>(box);
+}
+
+void ColumnWorld::stamp(const ColumnWorld &other, int offsetX, int offsetY, int offsetZ)
+{
+  //queues the compacted runs of other, translated by whole keys; runs moved out of key range are dropped.
+  //the capacity grows geometrically, reserving the exact size would copy all pending runs on every stamp
+  if (pending.size() + other.runs.size() > pending.capacity())
+    pending.reserve(std::max(2 * pending.capacity(), pending.size() + other.runs.size()));
+
+  for (size_t row = 0; row + 1 < other.rowOffsets.size(); ++row)
+  {
+    const int x = other.minKey[0] + static_cast<int>(row) + offsetX;
+    if (x < 0 || x > KEY_MAX)
+      continue;
+
+    for (size_t column = other.rowOffsets[row]; column < other.rowOffsets[row + 1]; ++column)
+    {
+      const int y = other.columnKeys[column] + offsetY;
+      if (y < 0 || y > KEY_MAX)
+        continue;
+
+      for (unsigned int r = other.columnOffsets[column]; r < other.columnOffsets[column + 1]; ++r)
+        addRun(x, y, clampKey(other.runs[r].begin + offsetZ), clampEnd(other.runs[r].end + offsetZ));
+    }
+  }
+}
+
+void ColumnWorld::merge(const ColumnWorld &other)
+{
+  for (size_t i = 0; i < other.pending.size(); ++i)
+    addRun(other.pending[i].x, other.pending[i].y, other.pending[i].run.begin, other.pending[i].run.end);
+  stamp(other, 0, 0, 0);
+  compact();
+}
+
+void ColumnWorld::subtract(const ColumnWorld &world, const ColumnWorld &other)
+{
+  //only the non-empty columns of world are visited and the matching columns of other are searched
+  //from the previous match on (both rows are sorted by y), so the cost follows what world occupies
+  //even if other is the large static world
+  reset(world.resolution);
+
+  for (size_t row = 0; row + 1 < world.rowOffsets.size(); ++row)
+  {
+    const octomap::key_type x = world.minKey[0] + row;
+    size_t otherColumn, otherColumnsEnd;
+    other.getRowColumns(x, otherColumn, otherColumnsEnd);
+
+    for (size_t column = world.rowOffsets[row]; column < world.rowOffsets[row + 1]; ++column)
+    {
+      const octomap::key_type y = world.columnKeys[column];
+      if (otherColumn < otherColumnsEnd && other.columnKeys[otherColumn] < y)
+        otherColumn = std::lower_bound(&other.columnKeys[0] + otherColumn, &other.columnKeys[0] + otherColumnsEnd, y) - &other.columnKeys[0];
+
+      const ZRun *otherRun = NULL, *otherEnd = NULL;
+      if (otherColumn < otherColumnsEnd && other.columnKeys[otherColumn] == y)
+        other.getColumnRuns(otherColumn, otherRun, otherEnd);
+
+      for (unsigned int r = world.columnOffsets[column]; r < world.columnOffsets[column + 1]; ++r)
+      {
+        const ZRun &run = world.runs[r];
+        int z = run.begin;
+        while (otherRun != otherEnd && otherRun->end <= z)
+          ++otherRun;
+
+        for (const ZRun *cut = otherRun; cut != otherEnd && cut->begin < run.end; ++cut)
+        {
+          if (cut->begin > z)
+            addRun(x, y, z, cut->begin);
+          z = std::max(z, cut->end);
+        }
+        if (z < run.end)
+          addRun(x, y, z, run.end);
+      }
+    }
+  }
+
+  compact();
+}
+
+bool ColumnWorld::comparePendingRuns(const PendingRun &a, const PendingRun &b)
+{
+  if (a.x != b.x)
+    return a.x < b.x;
+  if (a.y != b.y)
+    return a.y < b.y;
+  return a.run.begin < b.run.begin;
+}
+
+void ColumnWorld::sortPendingRuns()
+{
+  //shapes add their runs in (x, y) order, so pending mostly consists of a few sorted chunks, e.g.
+  //one per large primitive; those are merged pairwise, anything more scattered is sorted
+  const size_t maxChunks = 64;
+  std::vector<size_t> chunks(1, 0);
+  for (size_t i = 1; i < pending.size() && chunks.size() <= maxChunks; ++i)
+  {
+    if (comparePendingRuns(pending[i], pending[i - 1]))
+      chunks.push_back(i);
+  }
+
+  if (chunks.size() > maxChunks)
+  {
+    std::sort(pending.begin(), pending.end(), comparePendingRuns);
+    return;
+  }
+
+  chunks.push_back(pending.size());
+  while (chunks.size() > 2)
+  {
+    std::vector<size_t> merged(1, 0);
+    for (size_t k = 2; k < chunks.size(); k += 2)
+    {
+      std::inplace_merge(pending.begin() + chunks[k - 2], pending.begin() + chunks[k - 1], pending.begin() + chunks[k], comparePendingRuns);
+      merged.push_back(chunks[k]);
+    }
+    if (chunks.size() % 2 == 0)
+      merged.push_back(chunks.back());
+    chunks.swap(merged);
+  }
+}
+
+void ColumnWorld::queueDenseRuns()
+{
+  //columns are visited in (x, y) order and runs come out sorted along z
+  PendingRun pendingRun;
+  for (int x = dense.getMinKey(0); x <= dense.getMaxKey(0); ++x)
+  {
+    pendingRun.x = x;
+    for (int y = dense.getMinKey(1); y <= dense.getMaxKey(1); ++y)
+    {
+      pendingRun.y = y;
+      for (int z = 0; dense.findRun(x, y, z, pendingRun.run.begin, pendingRun.run.end); z = pendingRun.run.end)
+        pending.push_back(pendingRun);
+    }
+  }
+}
+
+void ColumnWorld::compactDense()
+{
+  //the grid holds the whole world including the runs compacted before and is read in (x, y) order,
+  //so the index is written directly instead of going through pending
+  octomap::key_type begin;
+  int end;
+  size_t numRuns = 0;
+  for (int x = dense.getMinKey(0); x <= dense.getMaxKey(0); ++x)
+  {
+    for (int y = dense.getMinKey(1); y <= dense.getMaxKey(1); ++y)
+    {
+      for (int z = 0; dense.findRun(x, y, z, begin, end); z = end)
+      {
+        if (numRuns++ == 0)
+        {
+          minKey[0] = maxKey[0] = x;
+          minKey[1] = maxKey[1] = y;
+          minKey[2] = begin;
+          maxKey[2] = end - 1;
+        }
+        maxKey[0] = x;
+        minKey[1] = std::min<octomap::key_type>(minKey[1], y);
+        maxKey[1] = std::max<octomap::key_type>(maxKey[1], y);
+        minKey[2] = std::min(minKey[2], begin);
+        maxKey[2] = std::max<octomap::key_type>(maxKey[2], end - 1);
+      }
+    }
+  }
+
+  runs.clear();
+  if (numRuns == 0)
+  {
+    minKey[0] = minKey[1] = minKey[2] = 0;
+    maxKey[0] = maxKey[1] = maxKey[2] = 0;
+  }
+  runs.reserve(numRuns);
+  clearIndex(numRuns == 0 ? 0 : maxKey[0] - minKey[0] + 1);
+
+  ZRun run;
+  size_t nextRow = 0;
+  if (numRuns == 0)
+  {
+    finishIndex(nextRow);
+    return;
+  }
+  for (int x = minKey[0]; x <= maxKey[0]; ++x)
+  {
+    for (int y = minKey[1]; y <= maxKey[1]; ++y)
+    {
+      for (int z = 0; dense.findRun(x, y, z, run.begin, run.end); z = run.end)
+        appendRun(x, y, run, nextRow);
+    }
+  }
+  finishIndex(nextRow);
+}
+
+void ColumnWorld::compact()
+{
+  if (pending.empty() && !denseDirty)
+    return;
+
+  if (denseComplete)
+  {
+    compactDense();
+    denseDirty = false;
+    return;
+  }
+
+  //re-queue already compacted runs so that one sort merges old and new data
+  //(the grid may repeat some of them, overlapping runs are merged below)
+  PendingRun pendingRun;
+  for (size_t row = 0; row + 1 < rowOffsets.size(); ++row)
+  {
+    pendingRun.x = minKey[0] + row;
+    for (size_t column = rowOffsets[row]; column < rowOffsets[row + 1]; ++column)
+    {
+      pendingRun.y = columnKeys[column];
+      for (unsigned int r = columnOffsets[column]; r < columnOffsets[column + 1]; ++r)
+      {
+        pendingRun.run = runs[r];
+        pending.push_back(pendingRun);
+      }
+    }
+  }
+  const bool usedDense = denseDirty;
+  if (usedDense)
+    queueDenseRuns();
+
+  sortPendingRuns();
+  denseDirty = false;
+
+  minKey[0] = pending.front().x;
+  maxKey[0] = pending.back().x;
+  minKey[1] = maxKey[1] = pending.front().y;
+  minKey[2] = pending.front().run.begin;
+  maxKey[2] = pending.front().run.end - 1;
+  for (size_t i = 1; i < pending.size(); ++i)
+  {
+    minKey[1] = std::min(minKey[1], pending[i].y);
+    maxKey[1] = std::max(maxKey[1], pending[i].y);
+    minKey[2] = std::min(minKey[2], pending[i].run.begin);
+    maxKey[2] = std::max<octomap::key_type>(maxKey[2], pending[i].run.end - 1);
+  }
+
+  runs.clear();
+  clearIndex(maxKey[0] - minKey[0] + 1);
+  size_t nextRow = 0;
+  for (size_t i = 0; i < pending.size(); ++i)
+    appendRun(pending[i].x, pending[i].y, pending[i].run, nextRow);
+  finishIndex(nextRow);
+
+  //capacity is kept so that a reused world does not reallocate, unless the grid was queued;
+  //then pending held a copy of the whole world
+  if (usedDense)
+    std::vector<PendingRun>().swap(pending);
+  else
+    pending.clear();
+}
+
+void ColumnWorld::clearIndex(size_t numRows)
+{
+  rowOffsets.assign(numRows + 1, 0);
+  columnKeys.clear();
+  columnOffsets.clear();
+}
+
+void ColumnWorld::appendRun(octomap::key_type x, octomap::key_type y, const ZRun &run, size_t &nextRow)
+{
+  const size_t row = x - minKey[0];
+  if (row + 1 > nextRow)
+  {
+    //first run of a new row; rows in between stay empty
+    for (; nextRow <= row; ++nextRow)
+      rowOffsets[nextRow] = columnKeys.size();
+  }
+  else if (columnKeys.back() == y)
+  {
+    if (run.begin <= runs.back().end)
+      runs.back().end = std::max(runs.back().end, run.end);
+    else
+      runs.push_back(run);
+    return;
+  }
+
+  columnKeys.push_back(y);
+  columnOffsets.push_back(runs.size());
+  runs.push_back(run);
+}
+
+void ColumnWorld::finishIndex(size_t &nextRow)
+{
+  for (; nextRow < rowOffsets.size(); ++nextRow)
+    rowOffsets[nextRow] = columnKeys.size();
+  columnOffsets.push_back(runs.size());
+}
+
+bool ColumnWorld::empty() const
+{
+  return runs.empty();
+}
+
+bool ColumnWorld::containsColumn(octomap::key_type x, octomap::key_type y) const
+{
+  return !runs.empty() && x >= minKey[0] && x <= maxKey[0] && y >= minKey[1] && y <= maxKey[1];
+}
+
+bool ColumnWorld::isColumnOccupied(octomap::key_type x, octomap::key_type y) const
+{
+  //only non-empty columns are indexed
+  size_t column;
+  return findColumn(x, y, column);
+}
+
+bool ColumnWorld::isOccupied(octomap::key_type x, octomap::key_type y, octomap::key_type z) const
+{
+  return isBandOccupied(x, y, z, z + 1);
+}
+
+bool ColumnWorld::isBandOccupied(octomap::key_type x, octomap::key_type y, int zBegin, int zEnd) const
+{
+  //a complete grid answers with an OR across the z words of the band
+  if (denseComplete && !denseDirty && zBegin < zEnd)
+    return dense.isBandOccupied(x, y, zBegin, zEnd);
+
+  const ZRun *begin, *end;
+  getColumnRuns(x, y, begin, end);
+
+  //first run that ends above zBegin; runs are sorted and disjoint
+  for (; begin != end && begin->end <= zBegin; ++begin)
+    ;
+
+  return begin != end && begin->begin < zEnd;
+}
+
+void ColumnWorld::getColumnRuns(octomap::key_type x, octomap::key_type y, const ZRun *&begin, const ZRun *&end) const
+{
+  begin = end = NULL;
+  size_t column;
+  if (findColumn(x, y, column))
+    getColumnRuns(column, begin, end);
+}
+
+size_t ColumnWorld::getNumRuns() const
+{
+  return runs.size();
+}
+
+const DenseGrid* ColumnWorld::getDenseGrid() const
+{
+  return denseComplete && !denseDirty ? &dense : NULL;
+}
+
+size_t ColumnWorld::getNumColumns() const
+{
+  return columnKeys.size();
+}
+
+void ColumnWorld::getRowColumns(int x, size_t &begin, size_t &end) const
+{
+  begin = end = 0;
+  if (runs.empty() || x < minKey[0] || x > maxKey[0])
+    return;
+
+  begin = rowOffsets[x - minKey[0]];
+  end = rowOffsets[x - minKey[0] + 1];
+}
+
+void ColumnWorld::getRowColumns(int x, int yBegin, int yEnd, size_t &begin, size_t &end) const
+{
+  //columns of the row with y in [yBegin, yEnd)
+  getRowColumns(x, begin, end);
+  if (begin == end)
+    return;
+
+  const octomap::key_type *keys = &columnKeys[0];
+  end = std::lower_bound(keys + begin, keys + end, yEnd) - keys;
+  begin = std::lower_bound(keys + begin, keys + end, yBegin) - keys;
+}
+
+octomap::key_type ColumnWorld::getColumnY(size_t column) const
+{
+  return columnKeys[column];
+}
+
+void ColumnWorld::getColumnRuns(size_t column, const ZRun *&begin, const ZRun *&end) const
+{
+  begin = &runs[0] + columnOffsets[column];
+  end = &runs[0] + columnOffsets[column + 1];
+}
+
+size_t ColumnWorld::memoryUsage() const
+{
+  return sizeof(ColumnWorld) + runs.capacity() * sizeof(ZRun) + rowOffsets.capacity() * sizeof(unsigned int)
+      + columnKeys.capacity() * sizeof(octomap::key_type) + columnOffsets.capacity() * sizeof(unsigned int)
+      + pending.capacity() * sizeof(PendingRun) + dense.memoryUsage();
+}
+
+octomap::key_type ColumnWorld::getMinKey(int axis) const
+{
+  return minKey[axis];
+}
+
+octomap::key_type ColumnWorld::getMaxKey(int axis) const
+{
+  return maxKey[axis];
+}
+
+double ColumnWorld::getMinCoord(int axis) const
+{
+  return (static_cast<int>(minKey[axis]) - KEY_CENTER) * resolution;
+}
+
+double ColumnWorld::getMaxCoord(int axis) const
+{
+  return (static_cast<int>(maxKey[axis]) + 1 - KEY_CENTER) * resolution;
+}
+
+double ColumnWorld::getResolution() const
+{
+  return resolution;
+}
+
+octomap::key_type ColumnWorld::coordToKey(double coordinate) const
+{
+  return clampKey(static_cast<int>(std::floor(coordinate / resolution)) + KEY_CENTER);
+}
+
+double ColumnWorld::keyToCoord(octomap::key_type key) const
+{
+  return (static_cast<int>(key) - KEY_CENTER + 0.5) * resolution;
+}
+
+double ColumnWorld::keyToBoundaryCoord(int key) const
+{
+  //lower face of the voxel with the given key
+  return (key - KEY_CENTER) * resolution;
+}
+
+bool ColumnWorld::coordsToKeySpan(double min, double max, int &begin, int &end) const
+{
+  //all keys whose voxel centres lie inside [min, max]
+  begin = clampKey(static_cast<int>(std::ceil(min / resolution - 0.5)) + KEY_CENTER);
+  end = clampEnd(static_cast<int>(std::floor(max / resolution - 0.5)) + KEY_CENTER + 1);
+  return begin < end;
+}
+
+bool ColumnWorld::findColumn(octomap::key_type x, octomap::key_type y, size_t &column) const
+{
+  if (!containsColumn(x, y))
+    return false;
+
+  //the columns of a row are sorted by y
+  const octomap::key_type *rowBegin = &columnKeys[0] + rowOffsets[x - minKey[0]];
+  const octomap::key_type *rowEnd = &columnKeys[0] + rowOffsets[x - minKey[0] + 1];
+  const octomap::key_type *key = std::lower_bound(rowBegin, rowEnd, y);
+  column = key - &columnKeys[0];
+  return key != rowEnd && *key == y;
+}
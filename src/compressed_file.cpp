@@ -0,0 +1,564 @@
+#include <simple_world_creator/compressed_file.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+//only the streaming interfaces that zstd 1.0 and lz4 1.7 already provide are used, see CMakeLists.txt
+#if defined(SIMPLE_WORLD_CREATOR_WITH_LZ4) && !defined(LZ4F_HEADER_SIZE_MAX)
+#define LZ4F_HEADER_SIZE_MAX 19
+#endif
+
+namespace
+{
+//first four bytes of a frame, little endian
+const unsigned char ZSTD_MAGIC[4] = {0x28, 0xb5, 0x2f, 0xfd};
+const unsigned char LZ4_MAGIC[4] = {0x04, 0x22, 0x4d, 0x18};
+
+//the codecs are optional at build time, see CMakeLists.txt
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+const bool HAS_ZSTD = true;
+#else
+const bool HAS_ZSTD = false;
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+const bool HAS_LZ4 = true;
+#else
+const bool HAS_LZ4 = false;
+#endif
+
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+LZ4F_preferences_t getLZ4Preferences(int level)
+{
+  LZ4F_preferences_t preferences;
+  std::memset(&preferences, 0, sizeof(preferences));
+  preferences.compressionLevel = level;
+  return preferences;
+}
+#endif
+}
+
+CompressionBuffer::CompressionBuffer() :
+    compression(COMPRESSION_NONE), level(0), context(NULL), finished(false), failed(false), inputBytes(0), outputBytes(0)
+{
+  setp(NULL, NULL);
+}
+
+CompressionBuffer::~CompressionBuffer()
+{
+  close();
+}
+
+bool CompressionBuffer::open(const std::string &fileName, Compression compression, int level)
+{
+  close();
+  if (!CompressedOutputFile::isAvailable(compression))
+    return false;
+
+  file.open(fileName.c_str(), std::ios::out | std::ios::binary);
+  if (!file.good())
+    return false;
+
+  this->compression = compression;
+  this->level = level;
+  finished = failed = false;
+  inputBytes = outputBytes = 0;
+
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+  if (compression == COMPRESSION_ZSTD)
+  {
+    ZSTD_CStream *zstdStream = ZSTD_createCStream();
+    if (zstdStream == NULL || ZSTD_isError(ZSTD_initCStream(zstdStream, level)))
+      failed = true;
+    context = zstdStream;
+    output.resize(ZSTD_CStreamOutSize());
+  }
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+  if (compression == COMPRESSION_LZ4)
+  {
+    LZ4F_compressionContext_t lz4Context = NULL;
+    LZ4F_createCompressionContext(&lz4Context, LZ4F_VERSION);
+    context = lz4Context;
+
+    //the frame header is written right away, blocks follow from the worker
+    const LZ4F_preferences_t preferences = getLZ4Preferences(level);
+    output.resize(std::max<size_t>(LZ4F_HEADER_SIZE_MAX, LZ4F_compressBound(BLOCK_SIZE, &preferences)));
+    const size_t size = LZ4F_compressBegin(lz4Context, &output[0], output.size(), &preferences);
+    if (LZ4F_isError(size) || !writeOutput(&output[0], size))
+      failed = true;
+  }
+#endif
+
+  block.resize(BLOCK_SIZE);
+  setp(&block[0], &block[0] + block.size());
+  worker = std::thread(&CompressionBuffer::compressLoop, this);
+  return true;
+}
+
+bool CompressionBuffer::close()
+{
+  if (!worker.joinable())
+    return !failed;
+
+  handOver();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  queueCondition.notify_all();
+  worker.join();
+  setp(NULL, NULL);
+
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+  if (compression == COMPRESSION_ZSTD)
+    ZSTD_freeCStream(static_cast<ZSTD_CStream*>(context));
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+  if (compression == COMPRESSION_LZ4)
+    LZ4F_freeCompressionContext(static_cast<LZ4F_compressionContext_t>(context));
+#endif
+  context = NULL;
+
+  file.close();
+  failed = failed || file.fail();
+  freeBlocks.clear();
+  return !failed;
+}
+
+uint64_t CompressionBuffer::getInputBytes() const
+{
+  return inputBytes;
+}
+
+uint64_t CompressionBuffer::getOutputBytes() const
+{
+  return outputBytes;
+}
+
+int CompressionBuffer::overflow(int c)
+{
+  if (pbase() == NULL)
+    return traits_type::eof();
+
+  handOver();
+  if (c != traits_type::eof())
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize CompressionBuffer::xsputn(const char *data, std::streamsize size)
+{
+  if (pbase() == NULL)
+    return 0;
+
+  std::streamsize written = 0;
+  while (written < size)
+  {
+    if (pptr() == epptr())
+      handOver();
+
+    const std::streamsize count = std::min<std::streamsize>(size - written, epptr() - pptr());
+    std::memcpy(pptr(), data + written, count);
+    pbump(count);
+    written += count;
+  }
+  return written;
+}
+
+void CompressionBuffer::handOver()
+{
+  //the filled block is queued and replaced by one the worker is done with
+  const size_t size = pptr() - pbase();
+  if (size == 0)
+    return;
+
+  block.resize(size);
+  inputBytes += size;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    queueCondition.wait(lock, [this]
+    { return queuedBlocks.size() < MAX_QUEUED_BLOCKS;});
+    queuedBlocks.push_back(std::vector<char>());
+    queuedBlocks.back().swap(block);
+    if (!freeBlocks.empty())
+    {
+      block.swap(freeBlocks.back());
+      freeBlocks.pop_back();
+    }
+  }
+  queueCondition.notify_all();
+
+  block.resize(BLOCK_SIZE);
+  setp(&block[0], &block[0] + block.size());
+}
+
+void CompressionBuffer::compressLoop()
+{
+  std::vector<char> current;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queueCondition.wait(lock, [this]
+      { return !queuedBlocks.empty() || finished;});
+      if (queuedBlocks.empty())
+        break;
+
+      current.swap(queuedBlocks.front());
+      queuedBlocks.pop_front();
+    }
+    queueCondition.notify_all();
+
+    //after a failure the rest is still drained, so that the producer never blocks
+    if (!failed && !compressBlock(current, false))
+      failed = true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBlocks.push_back(std::vector<char>());
+    freeBlocks.back().swap(current);
+  }
+
+  if (!failed && !compressBlock(std::vector<char>(), true))
+    failed = true;
+}
+
+bool CompressionBuffer::compressBlock(const std::vector<char> &block, bool last)
+{
+  if (compression == COMPRESSION_NONE)
+    return writeOutput(block.data(), block.size());
+
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+  if (compression == COMPRESSION_ZSTD)
+  {
+    ZSTD_CStream *zstdStream = static_cast<ZSTD_CStream*>(context);
+    ZSTD_inBuffer in = {block.data(), block.size(), 0};
+    while (true)
+    {
+      ZSTD_outBuffer out = {&output[0], output.size(), 0};
+      const size_t remaining = last ? ZSTD_endStream(zstdStream, &out) : ZSTD_compressStream(zstdStream, &out, &in);
+      if (ZSTD_isError(remaining) || !writeOutput(&output[0], out.pos))
+        return false;
+      if (last ? remaining == 0 : in.pos == in.size)
+        return true;
+    }
+  }
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+  if (compression == COMPRESSION_LZ4)
+  {
+    LZ4F_compressionContext_t lz4Context = static_cast<LZ4F_compressionContext_t>(context);
+    const size_t size = last ? LZ4F_compressEnd(lz4Context, &output[0], output.size(), NULL) :
+        LZ4F_compressUpdate(lz4Context, &output[0], output.size(), block.data(), block.size(), NULL);
+    return !LZ4F_isError(size) && writeOutput(&output[0], size);
+  }
+#endif
+  //only reached if the codec was not built in, last is unused then
+  static_cast<void>(last);
+  return false;
+}
+
+bool CompressionBuffer::writeOutput(const char *data, size_t size)
+{
+  file.write(data, size);
+  outputBytes += size;
+  return file.good();
+}
+
+CompressedOutputFile::CompressedOutputFile() :
+    std::ostream(NULL)
+{
+  rdbuf(&buffer);
+}
+
+bool CompressedOutputFile::parseCompression(const std::string &value, Compression &compression, int &level)
+{
+  //'none', 'lz4', 'zstd' or 'zstd:<level>'; lz4 levels above 2 select its high compression mode
+  const std::string name = value.substr(0, value.find(':'));
+  if (name == "none")
+    compression = COMPRESSION_NONE;
+  else if (name == "zstd")
+    compression = COMPRESSION_ZSTD;
+  else if (name == "lz4")
+    compression = COMPRESSION_LZ4;
+  else
+    return false;
+
+  level = compression == COMPRESSION_ZSTD ? 3 : 0;
+  if (name.size() < value.size())
+  {
+    std::istringstream iss(value.substr(name.size() + 1));
+    if (!(iss >> level))
+      return false;
+  }
+  return true;
+}
+
+bool CompressedOutputFile::isAvailable(Compression compression)
+{
+  return compression == COMPRESSION_NONE || (compression == COMPRESSION_ZSTD && HAS_ZSTD) || (compression == COMPRESSION_LZ4 && HAS_LZ4);
+}
+
+std::string CompressedOutputFile::getName(Compression compression)
+{
+  if (compression == COMPRESSION_ZSTD)
+    return "zstd";
+  if (compression == COMPRESSION_LZ4)
+    return "lz4";
+  return "none";
+}
+
+std::string CompressedOutputFile::getSuffix(Compression compression)
+{
+  if (compression == COMPRESSION_ZSTD)
+    return ".zst";
+  if (compression == COMPRESSION_LZ4)
+    return ".lz4";
+  return "";
+}
+
+bool CompressedOutputFile::open(const std::string &fileName, Compression compression, int level)
+{
+  this->fileName = fileName + getSuffix(compression);
+  clear();
+  if (!buffer.open(this->fileName, compression, level))
+  {
+    setstate(std::ios::failbit);
+    return false;
+  }
+  return true;
+}
+
+bool CompressedOutputFile::close()
+{
+  const bool success = !fail();
+  return buffer.close() && success;
+}
+
+const std::string& CompressedOutputFile::getFileName() const
+{
+  return fileName;
+}
+
+uint64_t CompressedOutputFile::getInputBytes() const
+{
+  return buffer.getInputBytes();
+}
+
+uint64_t CompressedOutputFile::getOutputBytes() const
+{
+  return buffer.getOutputBytes();
+}
+
+DecompressionBuffer::DecompressionBuffer() :
+    compression(COMPRESSION_NONE), context(NULL), inputBegin(0), inputEnd(0), frameComplete(true), failed(false)
+{
+  setg(NULL, NULL, NULL);
+}
+
+DecompressionBuffer::~DecompressionBuffer()
+{
+  close();
+}
+
+bool DecompressionBuffer::open(const std::string &fileName)
+{
+  close();
+  file.open(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!file.good())
+    return false;
+
+  input.resize(CHUNK_SIZE);
+  output.resize(CHUNK_SIZE);
+  inputBegin = inputEnd = 0;
+  failed = false;
+  fillInput();
+
+  compression = COMPRESSION_NONE;
+  if (inputEnd >= 4 && std::memcmp(&input[0], ZSTD_MAGIC, 4) == 0)
+    compression = COMPRESSION_ZSTD;
+  else if (inputEnd >= 4 && std::memcmp(&input[0], LZ4_MAGIC, 4) == 0)
+    compression = COMPRESSION_LZ4;
+
+  if (!CompressedOutputFile::isAvailable(compression))
+  {
+    file.close();
+    return false;
+  }
+  //a compressed file starts with a frame that has to be finished before the input ends
+  frameComplete = compression == COMPRESSION_NONE;
+
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+  if (compression == COMPRESSION_ZSTD)
+  {
+    ZSTD_DStream *zstdStream = ZSTD_createDStream();
+    if (zstdStream == NULL || ZSTD_isError(ZSTD_initDStream(zstdStream)))
+      failed = true;
+    context = zstdStream;
+  }
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+  if (compression == COMPRESSION_LZ4)
+  {
+    LZ4F_decompressionContext_t lz4Context = NULL;
+    LZ4F_createDecompressionContext(&lz4Context, LZ4F_VERSION);
+    context = lz4Context;
+  }
+#endif
+  return true;
+}
+
+void DecompressionBuffer::close()
+{
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+  if (compression == COMPRESSION_ZSTD && context != NULL)
+    ZSTD_freeDStream(static_cast<ZSTD_DStream*>(context));
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+  if (compression == COMPRESSION_LZ4 && context != NULL)
+    LZ4F_freeDecompressionContext(static_cast<LZ4F_decompressionContext_t>(context));
+#endif
+  context = NULL;
+  compression = COMPRESSION_NONE;
+  if (file.is_open())
+    file.close();
+  setg(NULL, NULL, NULL);
+}
+
+int DecompressionBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  const size_t size = decompress();
+  if (size == 0)
+    return traits_type::eof();
+
+  setg(&output[0], &output[0], &output[0] + size);
+  return traits_type::to_int_type(output[0]);
+}
+
+bool DecompressionBuffer::fillInput()
+{
+  file.read(&input[0], input.size());
+  inputBegin = 0;
+  inputEnd = file.gcount();
+  return inputEnd > 0;
+}
+
+size_t DecompressionBuffer::decompress()
+{
+  if (compression == COMPRESSION_NONE)
+  {
+    //plain files are passed through chunk by chunk
+    if (inputBegin == inputEnd && !fillInput())
+      return 0;
+    const size_t size = inputEnd - inputBegin;
+    output.swap(input);
+    inputBegin = inputEnd = 0;
+    return size;
+  }
+
+  //frames may end anywhere within a chunk, so this loops until some output is produced
+  while (!failed)
+  {
+    if (inputBegin == inputEnd && !fillInput() && frameComplete)
+      return 0;
+
+    //at the end of the input an unfinished frame may still flush buffered output, otherwise it was truncated
+    const bool inputEnded = inputBegin == inputEnd;
+    size_t produced = 0;
+#ifdef SIMPLE_WORLD_CREATOR_WITH_ZSTD
+    if (compression == COMPRESSION_ZSTD)
+    {
+      ZSTD_inBuffer in = {&input[0], inputEnd, inputBegin};
+      ZSTD_outBuffer out = {&output[0], output.size(), 0};
+      const size_t result = ZSTD_decompressStream(static_cast<ZSTD_DStream*>(context), &out, &in);
+      failed = ZSTD_isError(result);
+      frameComplete = result == 0;
+      inputBegin = in.pos;
+      produced = out.pos;
+    }
+#endif
+#ifdef SIMPLE_WORLD_CREATOR_WITH_LZ4
+    if (compression == COMPRESSION_LZ4)
+    {
+      size_t outputSize = output.size(), inputSize = inputEnd - inputBegin;
+      const size_t result = LZ4F_decompress(static_cast<LZ4F_decompressionContext_t>(context), &output[0], &outputSize, &input[inputBegin], &inputSize, NULL);
+      failed = LZ4F_isError(result);
+      frameComplete = result == 0;
+      inputBegin += inputSize;
+      produced = outputSize;
+    }
+#endif
+
+    if (produced > 0 && !failed)
+      return produced;
+    if (inputEnded && !frameComplete)
+      failed = true;
+  }
+  return 0;
+}
+
+bool DecompressionBuffer::hasFailed() const
+{
+  return failed;
+}
+
+CompressedInputFile::CompressedInputFile() :
+    std::istream(NULL)
+{
+  rdbuf(&buffer);
+}
+
+std::string CompressedInputFile::stripSuffix(const std::string &fileName)
+{
+  const size_t dot = fileName.rfind('.');
+  if (dot != std::string::npos && (fileName.compare(dot, std::string::npos, ".zst") == 0 || fileName.compare(dot, std::string::npos, ".lz4") == 0))
+    return fileName.substr(0, dot);
+  return fileName;
+}
+
+bool CompressedInputFile::decompressFile(const std::string &fileName)
+{
+  const std::string plainFileName = stripSuffix(fileName);
+  CompressedInputFile input;
+  if (plainFileName == fileName || !input.open(fileName))
+    return false;
+
+  std::ofstream output(plainFileName.c_str(), std::ios::out | std::ios::binary);
+  output << input.rdbuf();
+  output.close();
+  if (output.good() && !input.bad() && !input.hasFailed())
+    return true;
+
+  //a corrupt or truncated input must not leave a plain file that looks complete
+  std::remove(plainFileName.c_str());
+  return false;
+}
+
+bool CompressedInputFile::hasFailed() const
+{
+  return buffer.hasFailed();
+}
+
+bool CompressedInputFile::open(const std::string &fileName)
+{
+  clear();
+  if (buffer.open(fileName) || buffer.open(fileName + ".zst") || buffer.open(fileName + ".lz4"))
+    return true;
+
+  setstate(std::ios::failbit);
+  return false;
+}
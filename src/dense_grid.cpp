@@ -0,0 +1,193 @@
+#include <simple_world_creator/dense_grid.h>
+
+#include <algorithm>
+
+namespace
+{
+const uint64_t ALL_BITS = ~static_cast<uint64_t>(0);
+
+//bits [begin, 64) of a word
+uint64_t maskFrom(int begin)
+{
+  return ALL_BITS << begin;
+}
+
+//bits [0, end] of a word
+uint64_t maskUpTo(int end)
+{
+  return ALL_BITS >> (63 - end);
+}
+}
+
+DenseGrid::DenseGrid()
+{
+  clear();
+}
+
+size_t DenseGrid::getMemoryUsage(const octomap::key_type min[3], const octomap::key_type max[3])
+{
+  const size_t sizeX = max[0] - min[0] + 1, sizeY = max[1] - min[1] + 1, sizeZ = max[2] - min[2] + 1;
+  return sizeX * sizeY * ((sizeZ + 63) / 64) * sizeof(uint64_t);
+}
+
+void DenseGrid::reset(const octomap::key_type min[3], const octomap::key_type max[3])
+{
+  std::copy(min, min + 3, minKey);
+  std::copy(max, max + 3, maxKey);
+  sizeY = maxKey[1] - minKey[1] + 1;
+  sizeZ = maxKey[2] - minKey[2] + 1;
+  wordsPerColumn = (sizeZ + 63) / 64;
+  words.assign((maxKey[0] - minKey[0] + 1) * sizeY * wordsPerColumn, 0);
+}
+
+void DenseGrid::clear()
+{
+  //capacity is kept so that a reused world does not reallocate
+  words.clear();
+  minKey[0] = minKey[1] = minKey[2] = 1;
+  maxKey[0] = maxKey[1] = maxKey[2] = 0;
+  sizeY = 0;
+  sizeZ = 0;
+  wordsPerColumn = 0;
+}
+
+void DenseGrid::swap(DenseGrid &other)
+{
+  std::swap_ranges(minKey, minKey + 3, other.minKey);
+  std::swap_ranges(maxKey, maxKey + 3, other.maxKey);
+  std::swap(sizeY, other.sizeY);
+  std::swap(sizeZ, other.sizeZ);
+  std::swap(wordsPerColumn, other.wordsPerColumn);
+  words.swap(other.words);
+}
+
+bool DenseGrid::isAllocated() const
+{
+  return !words.empty();
+}
+
+bool DenseGrid::containsColumn(octomap::key_type x, octomap::key_type y) const
+{
+  return isAllocated() && x >= minKey[0] && x <= maxKey[0] && y >= minKey[1] && y <= maxKey[1];
+}
+
+bool DenseGrid::containsRun(octomap::key_type x, octomap::key_type y, octomap::key_type zBegin, int zEnd) const
+{
+  return containsColumn(x, y) && zBegin >= minKey[2] && zEnd <= maxKey[2] + 1;
+}
+
+const uint64_t* DenseGrid::getColumn(octomap::key_type x, octomap::key_type y) const
+{
+  return &words[((x - minKey[0]) * sizeY + (y - minKey[1])) * wordsPerColumn];
+}
+
+void DenseGrid::setRun(octomap::key_type x, octomap::key_type y, octomap::key_type zBegin, int zEnd)
+{
+  if (zBegin >= zEnd)
+    return;
+
+  uint64_t *column = const_cast<uint64_t*>(getColumn(x, y));
+  const int begin = zBegin - minKey[2], last = zEnd - 1 - minKey[2];
+  const int firstWord = begin >> 6, lastWord = last >> 6;
+
+  if (firstWord == lastWord)
+  {
+    column[firstWord] |= maskFrom(begin & 63) & maskUpTo(last & 63);
+    return;
+  }
+
+  //whole words in between are plain stores, which the compiler vectorizes
+  column[firstWord] |= maskFrom(begin & 63);
+  std::fill(column + firstWord + 1, column + lastWord, ALL_BITS);
+  column[lastWord] |= maskUpTo(last & 63);
+}
+
+bool DenseGrid::isBandOccupied(octomap::key_type x, octomap::key_type y, int zBegin, int zEnd) const
+{
+  const int begin = std::max(zBegin - static_cast<int>(minKey[2]), 0);
+  const int last = std::min(zEnd - 1 - static_cast<int>(minKey[2]), sizeZ - 1);
+  if (!containsColumn(x, y) || begin > last)
+    return false;
+
+  const uint64_t *column = getColumn(x, y);
+  const int firstWord = begin >> 6, lastWord = last >> 6;
+  if (firstWord == lastWord)
+    return (column[firstWord] & maskFrom(begin & 63) & maskUpTo(last & 63)) != 0;
+
+  uint64_t bits = (column[firstWord] & maskFrom(begin & 63)) | (column[lastWord] & maskUpTo(last & 63));
+  for (int w = firstWord + 1; w < lastWord; ++w)
+    bits |= column[w];
+  return bits != 0;
+}
+
+void DenseGrid::getBandState(octomap::key_type x, octomap::key_type y, int zBegin, int zEnd, bool &any, bool &all) const
+{
+  const int begin = std::max(zBegin - static_cast<int>(minKey[2]), 0);
+  const int last = std::min(zEnd - 1 - static_cast<int>(minKey[2]), sizeZ - 1);
+  any = all = false;
+  if (!containsColumn(x, y) || begin > last)
+    return;
+
+  //keys outside the grid are free, so a band reaching beyond it is never full
+  const bool inside = zBegin >= minKey[2] && zEnd <= maxKey[2] + 1;
+  const uint64_t *column = getColumn(x, y);
+  const int firstWord = begin >> 6, lastWord = last >> 6;
+  if (firstWord == lastWord)
+  {
+    const uint64_t mask = maskFrom(begin & 63) & maskUpTo(last & 63);
+    any = (column[firstWord] & mask) != 0;
+    all = inside && (column[firstWord] & mask) == mask;
+    return;
+  }
+
+  uint64_t anyBits = (column[firstWord] & maskFrom(begin & 63)) | (column[lastWord] & maskUpTo(last & 63));
+  uint64_t allBits = (column[firstWord] | ~maskFrom(begin & 63)) & (column[lastWord] | ~maskUpTo(last & 63));
+  for (int w = firstWord + 1; w < lastWord; ++w)
+  {
+    anyBits |= column[w];
+    allBits &= column[w];
+  }
+  any = anyBits != 0;
+  all = inside && allBits == ALL_BITS;
+}
+
+int DenseGrid::findBit(const uint64_t *column, int bit, bool value) const
+{
+  //index of the first bit at or above bit that equals value, or sizeZ
+  while (bit < sizeZ)
+  {
+    const int word = bit >> 6;
+    const uint64_t bits = (value ? column[word] : ~column[word]) & maskFrom(bit & 63);
+    if (bits != 0)
+      return std::min((word << 6) + __builtin_ctzll(bits), sizeZ);
+    bit = (word + 1) << 6;
+  }
+  return sizeZ;
+}
+
+bool DenseGrid::findRun(octomap::key_type x, octomap::key_type y, int z, octomap::key_type &begin, int &end) const
+{
+  const uint64_t *column = getColumn(x, y);
+  const int first = findBit(column, std::max(z - static_cast<int>(minKey[2]), 0), true);
+  if (first >= sizeZ)
+    return false;
+
+  begin = minKey[2] + first;
+  end = minKey[2] + findBit(column, first, false);
+  return true;
+}
+
+octomap::key_type DenseGrid::getMinKey(int axis) const
+{
+  return minKey[axis];
+}
+
+octomap::key_type DenseGrid::getMaxKey(int axis) const
+{
+  return maxKey[axis];
+}
+
+size_t DenseGrid::memoryUsage() const
+{
+  return words.capacity() * sizeof(uint64_t);
+}
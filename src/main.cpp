@@ -1,4 +1,5 @@
 #include <simple_world_creator/simple_world_creator.h>
+#include <simple_world_creator/batch_runner.h>
 
 int main(int argc, char* argv[])
 {
@@ -7,52 +8,89 @@ int main(int argc, char* argv[])
 
   if (argc < 3)
   {
-    printf("Usage: simple_world_creator <file> [WORLDS]     ([WORLDS] may include '--octomap', '--gazebo', and '--png')\n");
+    printf("Usage: simple_world_creator <file> [WORLDS]     ([WORLDS] may include '--octomap', '--gazebo', '--gazebo_batched', '--png', '--stl', '--obj', '--scans', '--animation', and '--stats')\n");
+    printf("       simple_world_creator --batch <directory|glob|manifest> [--threads <n>] [WORLDS]\n");
+    printf("       simple_world_creator <file|file.bt[.zst|.lz4]> --serve [--threads <n>] [WORLDS]\n");
+    printf("       simple_world_creator --decompress <file.zst|file.lz4>\n");
+    printf("       '--time_budget=<seconds>' aborts voxelization once the budget is used up\n");
+    printf("       '--serve' keeps the octree loaded and answers batched queries on '~query_world'\n");
+    printf("       '--compress=<zstd[:level]|lz4[:level]>' compresses all written files on a background thread\n");
     printf("\n");
     return 0;
   }
 
-  std::string fileName;
+  std::string fileName, batchSource, decompressSource;
+  int numThreads = 0;
+  bool serve = false;
+  std::vector<std::string> options;
   for (int i = 1; i < argc; ++i)
   {
     std::string s(argv[i]);
-    if (s[0] == '-')
-      continue;
-    fileName = s;
+    if (s == "--batch" && i + 1 < argc)
+      batchSource = argv[++i];
+    else if (s == "--threads" && i + 1 < argc)
+      numThreads = atoi(argv[++i]);
+    else if (s == "--serve")
+      serve = true;
+    else if (s == "--decompress" && i + 1 < argc)
+      decompressSource = argv[++i];
+    else if (s[0] == '-')
+      options.push_back(s);
+    else
+      fileName = s;
+  }
+
+  if (!batchSource.empty())
+  {
+    BatchRunner batchRunner(options, numThreads);
+    if (!batchRunner.collectWorldFiles(batchSource))
+      return 1;
+
+    const bool success = batchRunner.run();
+    batchRunner.printReport();
+    return success ? 0 : 1;
+  }
+
+  if (!decompressSource.empty())
+  {
+    if (CompressedInputFile::decompressFile(decompressSource))
+      return 0;
+    ROS_ERROR("Could not decompress '%s'.", decompressSource.c_str());
+    return 1;
+  }
+
+  //written octrees can be served directly, without the world config; compressed ones are read transparently
+  const std::string plainFileName = CompressedInputFile::stripSuffix(fileName);
+  if (serve && plainFileName.size() > 3 && plainFileName.compare(plainFileName.size() - 3, 3, ".bt") == 0)
+  {
+    octomap::OcTree octree(0.1);
+    CompressedInputFile file;
+    if (!file.open(fileName) || !octree.readBinary(file) || file.hasFailed())
+    {
+      ROS_ERROR("Issue reading the octree file. Could not serve queries.");
+      return 1;
+    }
+
+    QueryServer server(octree, numThreads);
+    ROS_INFO("Serving queries on '~query_world' (%zu octree nodes).", octree.size());
+    ros::spin();
+    return 0;
   }
 
   WorldCreator worldCreator(fileName);
 
-  if (!worldCreator.foundConfig)
+  if (!worldCreator.hasFoundConfig())
   {
     ROS_ERROR("Issue reading the config file. Could not create world files.");
     return 0;
   }
 
   worldCreator.setCreatePossibilities();
+  worldCreator.setNumThreads(numThreads);
 
-  for (int i = 1; i < argc; ++i)
-  {
-    std::string s(argv[i]);
-    if (s == "--octomap")
-    {
-      ROS_INFO("Creating octomap...");
-      worldCreator.createOctree();
-      ROS_INFO("Done!");
-    }
-    else if (s == "--gazebo")
-    {
-      ROS_INFO("Creating gazebo world file...");
-      worldCreator.createGazeboWorldFile();
-      ROS_INFO("Done!");
-    }
-    else if(s == "--png")
-    {
-      ROS_INFO("Creating png...");
-      worldCreator.createPNG();
-      ROS_INFO("Done!");
-    }
-  }
+  worldCreator.createWorldFiles(options, true);
+  if (serve)
+    worldCreator.serveQueries(numThreads);
 
   return 0;
 }
@@ -0,0 +1,321 @@
+#include <simple_world_creator/mesh_exporter.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+namespace
+{
+//appends [begin, end) z-ranges of the runs in a that are not covered by the runs in b
+void subtractRuns(const ZRun *a, const ZRun *aEnd, const ZRun *b, const ZRun *bEnd, std::vector<std::pair<int, int> > &result)
+{
+  result.clear();
+  for (; a != aEnd; ++a)
+  {
+    int current = a->begin;
+    for (; b != bEnd && b->end <= current; ++b)
+      ;
+
+    for (const ZRun *cover = b; cover != bEnd && cover->begin < a->end; ++cover)
+    {
+      if (cover->begin > current)
+        result.push_back(std::make_pair(current, static_cast<int>(cover->begin)));
+      current = std::max(current, cover->end);
+    }
+
+    if (current < a->end)
+      result.push_back(std::make_pair(current, a->end));
+  }
+}
+
+//runs of column y among the columns [column, end) of one row, which are sorted by y; column is
+//advanced to y, so a row is walked once when it is queried with increasing y
+void findRowColumn(const ColumnWorld &world, size_t &column, size_t end, int y, const ZRun *&run, const ZRun *&runEnd)
+{
+  for (; column < end && world.getColumnY(column) < y; ++column)
+    ;
+
+  run = runEnd = NULL;
+  if (column < end && world.getColumnY(column) == y)
+    world.getColumnRuns(column, run, runEnd);
+}
+}
+
+MeshExporter::MeshExporter(const ColumnWorld &world) :
+    world(world), format(FORMAT_STL), file(NULL), numQuads(0)
+{
+}
+
+bool MeshExporter::writeSTL(std::ostream &file)
+{
+  if (!file.good())
+    return false;
+
+  //compressed streams cannot seek, the count then comes from a pass that only counts
+  const std::streampos start = file.tellp();
+  numQuads = 0;
+  if (start == std::streampos(-1))
+  {
+    format = FORMAT_COUNT;
+    writeFaces();
+  }
+
+  this->file = &file;
+  format = FORMAT_STL;
+
+  char header[80];
+  std::memset(header, 0, sizeof(header));
+  std::strncpy(header, "simple_world_creator greedy voxel mesh", sizeof(header) - 1);
+  file.write(header, sizeof(header));
+
+  uint32_t numTriangles = getNumTriangles();
+  file.write(reinterpret_cast<const char*>(&numTriangles), sizeof(numTriangles));
+
+  numQuads = 0;
+  writeFaces();
+
+  //otherwise the triangle count is patched in once all faces have been streamed out
+  if (start != std::streampos(-1))
+  {
+    numTriangles = getNumTriangles();
+    file.seekp(start + std::streamoff(sizeof(header)));
+    file.write(reinterpret_cast<const char*>(&numTriangles), sizeof(numTriangles));
+    file.seekp(0, std::ios::end);
+  }
+
+  return file.good();
+}
+
+bool MeshExporter::writeOBJ(std::ostream &file)
+{
+  if (!file.good())
+    return false;
+
+  this->file = &file;
+  format = FORMAT_OBJ;
+  numQuads = 0;
+
+  //one normal per face direction, indexed 1 + 2 * axis + (positive ? 1 : 0)
+  file << "# simple_world_creator greedy voxel mesh" << std::endl;
+  file << "vn -1 0 0" << std::endl << "vn 1 0 0" << std::endl;
+  file << "vn 0 -1 0" << std::endl << "vn 0 1 0" << std::endl;
+  file << "vn 0 0 -1" << std::endl << "vn 0 0 1" << std::endl;
+
+  writeFaces();
+
+  return file.good();
+}
+
+size_t MeshExporter::getNumTriangles() const
+{
+  return 2 * numQuads;
+}
+
+bool MeshExporter::compareByRow(const FaceSpan &a, const FaceSpan &b)
+{
+  if (a.plane != b.plane)
+    return a.plane < b.plane;
+  if (a.row != b.row)
+    return a.row < b.row;
+  return a.begin < b.begin;
+}
+
+bool MeshExporter::compareBySpan(const FaceSpan &a, const FaceSpan &b)
+{
+  if (a.plane != b.plane)
+    return a.plane < b.plane;
+  if (a.begin != b.begin)
+    return a.begin < b.begin;
+  if (a.end != b.end)
+    return a.end < b.end;
+  return a.row < b.row;
+}
+
+void MeshExporter::writeFaces()
+{
+  if (world.empty())
+    return;
+
+  std::vector<FaceSpan> negative, positive;
+
+  //faces perpendicular to z are single cells, joined into spans along y first
+  collectTopBottomFaces(negative, positive);
+  joinAdjacentCells(negative);
+  joinAdjacentCells(positive);
+  mergeAndWriteSpans(negative, 2, false, 1, 0);
+  mergeAndWriteSpans(positive, 2, true, 1, 0);
+
+  //faces perpendicular to x and y already come as maximal spans along z
+  collectSideFaces(0, negative, positive);
+  mergeAndWriteSpans(negative, 0, false, 2, 1);
+  mergeAndWriteSpans(positive, 0, true, 2, 1);
+
+  collectSideFaces(1, negative, positive);
+  mergeAndWriteSpans(negative, 1, false, 2, 0);
+  mergeAndWriteSpans(positive, 1, true, 2, 0);
+}
+
+void MeshExporter::collectTopBottomFaces(std::vector<FaceSpan> &bottom, std::vector<FaceSpan> &top)
+{
+  bottom.clear();
+  top.clear();
+
+  FaceSpan cell;
+  for (int x = world.getMinKey(0); x <= world.getMaxKey(0); ++x)
+  {
+    size_t column, columnsEnd;
+    world.getRowColumns(x, column, columnsEnd);
+    for (; column < columnsEnd; ++column)
+    {
+      const int y = world.getColumnY(column);
+      const ZRun *run, *end;
+      world.getColumnRuns(column, run, end);
+      for (; run != end; ++run)
+      {
+        cell.begin = y;
+        cell.end = y + 1;
+        cell.row = x;
+
+        cell.plane = run->begin;
+        bottom.push_back(cell);
+        cell.plane = run->end;
+        top.push_back(cell);
+      }
+    }
+  }
+}
+
+void MeshExporter::collectSideFaces(int axis, std::vector<FaceSpan> &negative, std::vector<FaceSpan> &positive)
+{
+  negative.clear();
+  positive.clear();
+
+  std::vector<std::pair<int, int> > uncovered;
+  FaceSpan span;
+  for (int x = world.getMinKey(0); x <= world.getMaxKey(0); ++x)
+  {
+    //the neighbours on both sides are found by walking their rows along this one: the rows x - 1
+    //and x + 1 along x, or the row itself along y
+    size_t column, columnsEnd;
+    world.getRowColumns(x, column, columnsEnd);
+    size_t neighbor[2], neighborsEnd[2];
+    for (int side = 0; side < 2; ++side)
+      world.getRowColumns(axis == 0 ? x + 2 * side - 1 : x, neighbor[side], neighborsEnd[side]);
+
+    for (; column < columnsEnd; ++column)
+    {
+      const int y = world.getColumnY(column);
+      const ZRun *run, *end;
+      world.getColumnRuns(column, run, end);
+
+      const int position = axis == 0 ? x : y;
+      span.row = axis == 0 ? y : x;
+
+      for (int side = -1; side <= 1; side += 2)
+      {
+        const ZRun *neighborRun, *neighborEnd;
+        const int index = (side + 1) / 2;
+        findRowColumn(world, neighbor[index], neighborsEnd[index], axis == 0 ? y : y + side, neighborRun, neighborEnd);
+
+        subtractRuns(run, end, neighborRun, neighborEnd, uncovered);
+
+        span.plane = side < 0 ? position : position + 1;
+        std::vector<FaceSpan> &faces = side < 0 ? negative : positive;
+        for (size_t i = 0; i < uncovered.size(); ++i)
+        {
+          span.begin = uncovered[i].first;
+          span.end = uncovered[i].second;
+          faces.push_back(span);
+        }
+      }
+    }
+  }
+}
+
+void MeshExporter::joinAdjacentCells(std::vector<FaceSpan> &cells)
+{
+  std::sort(cells.begin(), cells.end(), compareByRow);
+
+  size_t joined = 0;
+  for (size_t i = 0; i < cells.size(); ++i)
+  {
+    if (joined > 0 && cells[joined - 1].plane == cells[i].plane && cells[joined - 1].row == cells[i].row && cells[joined - 1].end == cells[i].begin)
+      cells[joined - 1].end = cells[i].end;
+    else
+      cells[joined++] = cells[i];
+  }
+  cells.resize(joined);
+}
+
+void MeshExporter::mergeAndWriteSpans(std::vector<FaceSpan> &spans, int axis, bool positive, int spanAxis, int rowAxis)
+{
+  //identical spans on consecutive rows of the same plane form one rectangle
+  std::sort(spans.begin(), spans.end(), compareBySpan);
+
+  int begin[3], end[3];
+  for (size_t i = 0; i < spans.size();)
+  {
+    size_t j = i + 1;
+    for (; j < spans.size() && spans[j].plane == spans[i].plane && spans[j].begin == spans[i].begin && spans[j].end == spans[i].end
+            && spans[j].row == spans[j - 1].row + 1; ++j)
+      ;
+
+    begin[axis] = end[axis] = spans[i].plane;
+    begin[spanAxis] = spans[i].begin;
+    end[spanAxis] = spans[i].end;
+    begin[rowAxis] = spans[i].row;
+    end[rowAxis] = spans[j - 1].row + 1;
+    writeQuad(axis, positive, spans[i].plane, begin, end);
+
+    i = j;
+  }
+}
+
+void MeshExporter::writeQuad(int axis, bool positive, int plane, const int begin[3], const int end[3])
+{
+  if (format == FORMAT_COUNT)
+  {
+    ++numQuads;
+    return;
+  }
+
+  //corners counter-clockwise around +axis, reversed for faces pointing to -axis
+  const int u = (axis + 1) % 3;
+  const int v = (axis + 2) % 3;
+  const int cornerU[4] = {begin[u], end[u], end[u], begin[u]};
+  const int cornerV[4] = {begin[v], begin[v], end[v], end[v]};
+
+  float corners[4][3];
+  for (int c = 0; c < 4; ++c)
+  {
+    const int index = positive ? c : 3 - c;
+    corners[index][axis] = world.keyToBoundaryCoord(plane);
+    corners[index][u] = world.keyToBoundaryCoord(cornerU[c]);
+    corners[index][v] = world.keyToBoundaryCoord(cornerV[c]);
+  }
+
+  ++numQuads;
+
+  std::ostream &file = *this->file;
+  if (format == FORMAT_OBJ)
+  {
+    const int normal = 1 + 2 * axis + (positive ? 1 : 0);
+    for (int c = 0; c < 4; ++c)
+      file << "v " << corners[c][0] << " " << corners[c][1] << " " << corners[c][2] << "\n";
+    file << "f -4//" << normal << " -3//" << normal << " -2//" << normal << " -1//" << normal << "\n";
+    return;
+  }
+
+  //binary stl triangle: normal, three vertices, attribute byte count (little endian floats)
+  float normal[3] = {0.0f, 0.0f, 0.0f};
+  normal[axis] = positive ? 1.0f : -1.0f;
+  const uint16_t attributes = 0;
+  const int triangles[2][3] = { {0, 1, 2}, {0, 2, 3}};
+  for (int t = 0; t < 2; ++t)
+  {
+    file.write(reinterpret_cast<const char*>(normal), sizeof(normal));
+    for (int c = 0; c < 3; ++c)
+      file.write(reinterpret_cast<const char*>(corners[triangles[t][c]]), sizeof(corners[0]));
+    file.write(reinterpret_cast<const char*>(&attributes), sizeof(attributes));
+  }
+}
@@ -0,0 +1,316 @@
+#include <simple_world_creator/primitive_store.h>
+#include <simple_world_creator/shape_kernels.h>
+
+#include <cstring>
+#include <stdint.h>
+
+namespace
+{
+template<typename T>
+size_t vectorMemory(const std::vector<T> &v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+template<typename T>
+void shrinkVector(std::vector<T> &v)
+{
+  std::vector<T>(v).swap(v);
+}
+}
+
+NameArena::NameArena() :
+    numNames(0)
+{
+}
+
+unsigned int NameArena::intern(const std::string &name)
+{
+  //the table is kept at most half full
+  if (2 * (numNames + 1) > slots.size())
+  {
+    size_t numSlots = 64;
+    while (numSlots < 4 * (numNames + 1))
+      numSlots *= 2;
+    rehash(numSlots);
+  }
+
+  const size_t mask = slots.size() - 1;
+  size_t slot = hashName(name.c_str(), name.size()) & mask;
+  for (; slots[slot] != 0; slot = (slot + 1) & mask)
+  {
+    if (name.compare(data.c_str() + slots[slot] - 1) == 0)
+      return slots[slot] - 1;
+  }
+
+  const unsigned int id = data.size();
+  data.append(name);
+  data.push_back('\0');
+  slots[slot] = id + 1;
+  ++numNames;
+  return id;
+}
+
+const char* NameArena::get(unsigned int id) const
+{
+  return data.c_str() + id;
+}
+
+void NameArena::shrinkToFit()
+{
+  std::vector<unsigned int>().swap(slots);
+  std::string(data).swap(data);
+}
+
+size_t NameArena::hashName(const char *name, size_t length)
+{
+  //FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i)
+  {
+    hash ^= static_cast<unsigned char>(name[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void NameArena::rehash(size_t numSlots)
+{
+  slots.assign(numSlots, 0);
+  const size_t mask = numSlots - 1;
+  for (size_t id = 0; id < data.size();)
+  {
+    const size_t length = std::strlen(data.c_str() + id);
+    size_t slot = hashName(data.c_str() + id, length) & mask;
+    for (; slots[slot] != 0; slot = (slot + 1) & mask)
+      ;
+    slots[slot] = id + 1;
+    id += length + 1;
+  }
+}
+
+size_t NameArena::memoryUsage() const
+{
+  return data.capacity() + vectorMemory(slots);
+}
+
+void PrimitiveStore::reserve(size_t numBoxes, size_t numSpheres, size_t numCylinders, size_t numPolygonPrisms, size_t numCapsules)
+{
+  boxes.centerX.reserve(numBoxes);
+  boxes.centerY.reserve(numBoxes);
+  boxes.bottomZ.reserve(numBoxes);
+  boxes.sizeX.reserve(numBoxes);
+  boxes.sizeY.reserve(numBoxes);
+  boxes.sizeZ.reserve(numBoxes);
+  boxes.angle.reserve(numBoxes);
+  boxes.name.reserve(numBoxes);
+
+  spheres.centerX.reserve(numSpheres);
+  spheres.centerY.reserve(numSpheres);
+  spheres.bottomZ.reserve(numSpheres);
+  spheres.radius.reserve(numSpheres);
+  spheres.name.reserve(numSpheres);
+
+  cylinders.centerX.reserve(numCylinders);
+  cylinders.centerY.reserve(numCylinders);
+  cylinders.bottomZ.reserve(numCylinders);
+  cylinders.radius.reserve(numCylinders);
+  cylinders.height.reserve(numCylinders);
+  cylinders.name.reserve(numCylinders);
+
+  polygonPrisms.firstVertex.reserve(numPolygonPrisms);
+  polygonPrisms.numVertices.reserve(numPolygonPrisms);
+  polygonPrisms.bottomZ.reserve(numPolygonPrisms);
+  polygonPrisms.height.reserve(numPolygonPrisms);
+  polygonPrisms.name.reserve(numPolygonPrisms);
+
+  capsules.startX.reserve(numCapsules);
+  capsules.startY.reserve(numCapsules);
+  capsules.startZ.reserve(numCapsules);
+  capsules.endX.reserve(numCapsules);
+  capsules.endY.reserve(numCapsules);
+  capsules.endZ.reserve(numCapsules);
+  capsules.radius.reserve(numCapsules);
+  capsules.name.reserve(numCapsules);
+}
+
+void PrimitiveStore::shrinkToFit()
+{
+  shrinkVector(boxes.centerX);
+  shrinkVector(boxes.centerY);
+  shrinkVector(boxes.bottomZ);
+  shrinkVector(boxes.sizeX);
+  shrinkVector(boxes.sizeY);
+  shrinkVector(boxes.sizeZ);
+  shrinkVector(boxes.angle);
+  shrinkVector(boxes.name);
+
+  shrinkVector(spheres.centerX);
+  shrinkVector(spheres.centerY);
+  shrinkVector(spheres.bottomZ);
+  shrinkVector(spheres.radius);
+  shrinkVector(spheres.name);
+
+  shrinkVector(cylinders.centerX);
+  shrinkVector(cylinders.centerY);
+  shrinkVector(cylinders.bottomZ);
+  shrinkVector(cylinders.radius);
+  shrinkVector(cylinders.height);
+  shrinkVector(cylinders.name);
+
+  shrinkVector(polygonPrisms.firstVertex);
+  shrinkVector(polygonPrisms.numVertices);
+  shrinkVector(polygonPrisms.vertexX);
+  shrinkVector(polygonPrisms.vertexY);
+  shrinkVector(polygonPrisms.bottomZ);
+  shrinkVector(polygonPrisms.height);
+  shrinkVector(polygonPrisms.name);
+
+  shrinkVector(capsules.startX);
+  shrinkVector(capsules.startY);
+  shrinkVector(capsules.startZ);
+  shrinkVector(capsules.endX);
+  shrinkVector(capsules.endY);
+  shrinkVector(capsules.endZ);
+  shrinkVector(capsules.radius);
+  shrinkVector(capsules.name);
+
+  names.shrinkToFit();
+}
+
+void PrimitiveStore::addBox(const ObjectBox &box)
+{
+  boxes.centerX.push_back(box.bottomCenter[0]);
+  boxes.centerY.push_back(box.bottomCenter[1]);
+  boxes.bottomZ.push_back(box.bottomCenter[2]);
+  boxes.sizeX.push_back(box.size[0]);
+  boxes.sizeY.push_back(box.size[1]);
+  boxes.sizeZ.push_back(box.size[2]);
+  boxes.angle.push_back(box.angle);
+  boxes.name.push_back(names.intern(box.name));
+}
+
+void PrimitiveStore::addSphere(const ObjectSphere &sphere)
+{
+  spheres.centerX.push_back(sphere.bottom[0]);
+  spheres.centerY.push_back(sphere.bottom[1]);
+  spheres.bottomZ.push_back(sphere.bottom[2]);
+  spheres.radius.push_back(sphere.radius);
+  spheres.name.push_back(names.intern(sphere.name));
+}
+
+void PrimitiveStore::addCylinder(const ObjectCylinder &cylinder)
+{
+  cylinders.centerX.push_back(cylinder.bottom[0]);
+  cylinders.centerY.push_back(cylinder.bottom[1]);
+  cylinders.bottomZ.push_back(cylinder.bottom[2]);
+  cylinders.radius.push_back(cylinder.radius);
+  cylinders.height.push_back(cylinder.height);
+  cylinders.name.push_back(names.intern(cylinder.name));
+}
+
+void PrimitiveStore::addPolygonPrism(const ObjectPolygonPrism &polygonPrism)
+{
+  polygonPrisms.firstVertex.push_back(polygonPrisms.vertexX.size());
+  polygonPrisms.numVertices.push_back(polygonPrism.points.size() / 2);
+  for (size_t i = 0; i + 1 < polygonPrism.points.size(); i += 2)
+  {
+    polygonPrisms.vertexX.push_back(polygonPrism.points[i]);
+    polygonPrisms.vertexY.push_back(polygonPrism.points[i + 1]);
+  }
+  polygonPrisms.bottomZ.push_back(polygonPrism.bottom);
+  polygonPrisms.height.push_back(polygonPrism.height);
+  polygonPrisms.name.push_back(names.intern(polygonPrism.name));
+}
+
+void PrimitiveStore::addCapsule(const ObjectCapsule &capsule)
+{
+  capsules.startX.push_back(capsule.start[0]);
+  capsules.startY.push_back(capsule.start[1]);
+  capsules.startZ.push_back(capsule.start[2]);
+  capsules.endX.push_back(capsule.end[0]);
+  capsules.endY.push_back(capsule.end[1]);
+  capsules.endZ.push_back(capsule.end[2]);
+  capsules.radius.push_back(capsule.radius);
+  capsules.name.push_back(names.intern(capsule.name));
+}
+
+void PrimitiveStore::getBox(size_t i, ObjectBox &box) const
+{
+  box.name = names.get(boxes.name[i]);
+  box.bottomCenter[0] = boxes.centerX[i];
+  box.bottomCenter[1] = boxes.centerY[i];
+  box.bottomCenter[2] = boxes.bottomZ[i];
+  box.size[0] = boxes.sizeX[i];
+  box.size[1] = boxes.sizeY[i];
+  box.size[2] = boxes.sizeZ[i];
+  box.angle = boxes.angle[i];
+}
+
+void PrimitiveStore::getSphere(size_t i, ObjectSphere &sphere) const
+{
+  sphere.name = names.get(spheres.name[i]);
+  sphere.bottom[0] = spheres.centerX[i];
+  sphere.bottom[1] = spheres.centerY[i];
+  sphere.bottom[2] = spheres.bottomZ[i];
+  sphere.radius = spheres.radius[i];
+}
+
+void PrimitiveStore::getCylinder(size_t i, ObjectCylinder &cylinder) const
+{
+  cylinder.name = names.get(cylinders.name[i]);
+  cylinder.bottom[0] = cylinders.centerX[i];
+  cylinder.bottom[1] = cylinders.centerY[i];
+  cylinder.bottom[2] = cylinders.bottomZ[i];
+  cylinder.radius = cylinders.radius[i];
+  cylinder.height = cylinders.height[i];
+}
+
+void PrimitiveStore::getPolygonPrism(size_t i, ObjectPolygonPrism &polygonPrism) const
+{
+  polygonPrism.name = names.get(polygonPrisms.name[i]);
+  polygonPrism.points.clear();
+  const unsigned int first = polygonPrisms.firstVertex[i];
+  for (unsigned int v = first; v < first + polygonPrisms.numVertices[i]; ++v)
+  {
+    polygonPrism.points.push_back(polygonPrisms.vertexX[v]);
+    polygonPrism.points.push_back(polygonPrisms.vertexY[v]);
+  }
+  polygonPrism.bottom = polygonPrisms.bottomZ[i];
+  polygonPrism.height = polygonPrisms.height[i];
+}
+
+void PrimitiveStore::getCapsule(size_t i, ObjectCapsule &capsule) const
+{
+  capsule.name = names.get(capsules.name[i]);
+  capsule.start[0] = capsules.startX[i];
+  capsule.start[1] = capsules.startY[i];
+  capsule.start[2] = capsules.startZ[i];
+  capsule.end[0] = capsules.endX[i];
+  capsule.end[1] = capsules.endY[i];
+  capsule.end[2] = capsules.endZ[i];
+  capsule.radius = capsules.radius[i];
+}
+
+size_t PrimitiveStore::size() const
+{
+  return boxes.size() + spheres.size() + cylinders.size() + polygonPrisms.size() + capsules.size();
+}
+
+bool PrimitiveStore::empty() const
+{
+  return size() == 0;
+}
+
+size_t PrimitiveStore::memoryUsage() const
+{
+  return vectorMemory(boxes.centerX) + vectorMemory(boxes.centerY) + vectorMemory(boxes.bottomZ) + vectorMemory(boxes.sizeX)
+      + vectorMemory(boxes.sizeY) + vectorMemory(boxes.sizeZ) + vectorMemory(boxes.angle) + vectorMemory(boxes.name)
+      + vectorMemory(spheres.centerX) + vectorMemory(spheres.centerY) + vectorMemory(spheres.bottomZ) + vectorMemory(spheres.radius)
+      + vectorMemory(spheres.name) + vectorMemory(cylinders.centerX) + vectorMemory(cylinders.centerY) + vectorMemory(cylinders.bottomZ)
+      + vectorMemory(cylinders.radius) + vectorMemory(cylinders.height) + vectorMemory(cylinders.name) + vectorMemory(polygonPrisms.firstVertex)
+      + vectorMemory(polygonPrisms.numVertices) + vectorMemory(polygonPrisms.vertexX) + vectorMemory(polygonPrisms.vertexY)
+      + vectorMemory(polygonPrisms.bottomZ) + vectorMemory(polygonPrisms.height) + vectorMemory(polygonPrisms.name) + vectorMemory(capsules.startX)
+      + vectorMemory(capsules.startY) + vectorMemory(capsules.startZ) + vectorMemory(capsules.endX) + vectorMemory(capsules.endY)
+      + vectorMemory(capsules.endZ) + vectorMemory(capsules.radius) + vectorMemory(capsules.name) + names.memoryUsage();
+}
@@ -0,0 +1,34 @@
+#include <simple_world_creator/query_server.h>
+
+#include <chrono>
+
+QueryServer::QueryServer(const octomap::OcTree &octree, int numThreads) :
+    query(octree, numThreads), nodeHandle("~")
+{
+  service = nodeHandle.advertiseService("query_world", &QueryServer::handleQuery, this);
+}
+
+bool QueryServer::handleQuery(simple_world_creator::QueryWorld::Request &request, simple_world_creator::QueryWorld::Response &response)
+{
+  if (request.points.size() % 3 != 0 || request.boxes.size() % 6 != 0 || request.rays.size() % 6 != 0 || request.distance_points.size() % 3 != 0)
+  {
+    ROS_WARN("Rejected query, points need 3 values, boxes and rays 6 values each.");
+    return false;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  response.point_states.resize(request.points.size() / 3);
+  response.box_occupied.resize(request.boxes.size() / 6);
+  response.ray_ranges.resize(request.rays.size() / 6);
+  response.distances.resize(request.distance_points.size() / 3);
+
+  query.queryPoints(request.points.data(), response.point_states.size(), response.point_states.data());
+  query.queryBoxes(request.boxes.data(), response.box_occupied.size(), response.box_occupied.data());
+  query.castRays(request.rays.data(), response.ray_ranges.size(), request.max_range, response.ray_ranges.data());
+  query.queryDistances(request.distance_points.data(), response.distances.size(), request.max_distance, response.distances.data());
+
+  ROS_DEBUG("Answered %zu queries in %.3f ms.", response.point_states.size() + response.box_occupied.size() + response.ray_ranges.size()
+            + response.distances.size(), 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  return true;
+}
@@ -0,0 +1,496 @@
+#include <simple_world_creator/scan_simulator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdint.h>
+
+namespace
+{
+template<typename T>
+void writeValue(std::ostream &file, T value)
+{
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool parseAngles(const std::string &value, double values[3])
+{
+  //first and last angle in degrees followed by a positive count
+  if (!ShapeKernelBase::parseValues(value, values, 3) || values[2] < 1.0)
+    return false;
+  values[0] *= M_PI / 180.0;
+  values[1] *= M_PI / 180.0;
+  values[2] = std::floor(values[2]);
+  return true;
+}
+
+double getAngle(const double angles[3], int i)
+{
+  return angles[2] > 1.0 ? angles[0] + (angles[1] - angles[0]) * i / (angles[2] - 1.0) : angles[0];
+}
+
+const int NUM_BINS = 12;
+
+//bounds and number of the primitives that fall into one bin of the split search
+struct Bin
+{
+  double min[3], max[3];
+  size_t count;
+
+  Bin() :
+      count(0)
+  {
+    std::fill(min, min + 3, HUGE_VAL);
+    std::fill(max, max + 3, -HUGE_VAL);
+  }
+
+  void add(const double *primitiveMin, const double *primitiveMax)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      min[axis] = std::min(min[axis], primitiveMin[axis]);
+      max[axis] = std::max(max[axis], primitiveMax[axis]);
+    }
+    ++count;
+  }
+
+  Bin merged(const Bin &other) const
+  {
+    Bin bin = other;
+    if (count > 0)
+    {
+      bin.add(min, max);
+      bin.count += count - 1;
+    }
+    return bin;
+  }
+
+  double getArea() const
+  {
+    const double size[3] = {max[0] - min[0], max[1] - min[1], max[2] - min[2]};
+    return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+  }
+};
+
+//rotation from the sensor frame into the world frame, yaw around z after pitch around y after roll around x
+void getRotation(double roll, double pitch, double yaw, double rotation[3][3])
+{
+  const double cr = cos(roll), sr = sin(roll), cp = cos(pitch), sp = sin(pitch), cy = cos(yaw), sy = sin(yaw);
+  rotation[0][0] = cy * cp;
+  rotation[0][1] = cy * sp * sr - sy * cr;
+  rotation[0][2] = cy * sp * cr + sy * sr;
+  rotation[1][0] = sy * cp;
+  rotation[1][1] = sy * sp * sr + cy * cr;
+  rotation[1][2] = sy * sp * cr - cy * sr;
+  rotation[2][0] = -sp;
+  rotation[2][1] = cp * sr;
+  rotation[2][2] = cp * cr;
+}
+}
+
+unsigned int ScanSimulator::readField(const std::string &key, const std::string &value, ObjectScan &scan)
+{
+  if (key == "name")
+  {
+    scan.name = value;
+    return FIELD_NAME;
+  }
+  else if (key == "type")
+  {
+    if (value == "laser_2d")
+      scan.type = SCAN_LASER_2D;
+    else if (value == "multi_beam")
+      scan.type = SCAN_MULTI_BEAM;
+    else if (value == "depth_camera")
+      scan.type = SCAN_DEPTH_CAMERA;
+    else
+      return 0;
+    return FIELD_TYPE;
+  }
+  else if (key == "poses")
+  {
+    //x y z roll pitch yaw per pose, angles in degrees
+    scan.poses.clear();
+    std::istringstream iss(value);
+    double number;
+    while (iss >> number)
+      scan.poses.push_back(scan.poses.size() % 6 >= 3 ? number * M_PI / 180.0 : number);
+    return !scan.poses.empty() && scan.poses.size() % 6 == 0 ? FIELD_POSES : 0;
+  }
+  else if (key == "horizontal")
+    return parseAngles(value, scan.horizontal) ? FIELD_HORIZONTAL : 0;
+  else if (key == "vertical")
+    return parseAngles(value, scan.vertical) ? FIELD_VERTICAL : 0;
+  else if (key == "image")
+  {
+    //width and height in pixels, horizontal field of view in degrees
+    if (!ShapeKernelBase::parseValues(value, scan.image, 3) || scan.image[0] < 1.0 || scan.image[1] < 1.0 || scan.image[2] <= 0.0
+        || scan.image[2] >= 180.0)
+      return 0;
+    scan.image[0] = std::floor(scan.image[0]);
+    scan.image[1] = std::floor(scan.image[1]);
+    scan.image[2] *= M_PI / 180.0;
+    return FIELD_IMAGE;
+  }
+  else if (key == "range")
+    return ShapeKernelBase::parseValues(value, scan.range, 2) && scan.range[0] < scan.range[1] ? FIELD_RANGE : 0;
+  else if (key == "output" && (value == "ranges" || value == "points"))
+  {
+    scan.points = value == "points";
+    return FIELD_OUTPUT;
+  }
+  return 0;
+}
+
+unsigned int ScanSimulator::getRequiredFields(const ObjectScan &scan)
+{
+  const unsigned int fields = FIELD_NAME | FIELD_TYPE | FIELD_POSES | FIELD_RANGE | FIELD_OUTPUT;
+  if (scan.type == SCAN_LASER_2D)
+    return fields | FIELD_HORIZONTAL;
+  if (scan.type == SCAN_MULTI_BEAM)
+    return fields | FIELD_HORIZONTAL | FIELD_VERTICAL;
+  return fields | FIELD_IMAGE;
+}
+
+void ScanSimulator::getRayDirections(const ObjectScan &scan, std::vector<double> &directions)
+{
+  //neighbouring rays are stored next to each other, so that packets stay coherent
+  directions.clear();
+  if (scan.type == SCAN_DEPTH_CAMERA)
+  {
+    const int width = scan.image[0], height = scan.image[1];
+    const double focalLength = 0.5 * width / tan(0.5 * scan.image[2]);
+    for (int v = 0; v < height; ++v)
+    {
+      for (int u = 0; u < width; ++u)
+      {
+        directions.push_back(1.0);
+        directions.push_back((0.5 * width - u - 0.5) / focalLength);
+        directions.push_back((0.5 * height - v - 0.5) / focalLength);
+      }
+    }
+    return;
+  }
+
+  const int beams = scan.type == SCAN_MULTI_BEAM ? scan.vertical[2] : 1;
+  for (int b = 0; b < beams; ++b)
+  {
+    const double elevation = scan.type == SCAN_MULTI_BEAM ? getAngle(scan.vertical, b) : 0.0;
+    for (int i = 0; i < scan.horizontal[2]; ++i)
+    {
+      const double angle = getAngle(scan.horizontal, i);
+      directions.push_back(cos(elevation) * cos(angle));
+      directions.push_back(cos(elevation) * sin(angle));
+      directions.push_back(sin(elevation));
+    }
+  }
+}
+
+ScanSimulator::ScanSimulator()
+{
+}
+
+void ScanSimulator::addPrimitives(const PrimitiveStore &store, const double offset[3])
+{
+  //kernel indices as in the gazebo batching
+  addShapes<BoxKernel>(store, offset, 0, boxes);
+  addShapes<SphereKernel>(store, offset, 1, spheres);
+  addShapes<CylinderKernel>(store, offset, 2, cylinders);
+  addShapes<PolygonPrismKernel>(store, offset, 3, polygonPrisms);
+  addShapes<CapsuleKernel>(store, offset, 4, capsules);
+}
+
+template<typename Kernel>
+void ScanSimulator::addShapes(const PrimitiveStore &store, const double offset[3], int kernel, std::vector<typename Kernel::Shape> &shapes)
+{
+  const typename Kernel::Columns &columns = Kernel::getColumns(store);
+  typename Kernel::Shape shape;
+  PrimitiveRef ref;
+  ref.kernel = kernel;
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    Kernel::getShape(columns, i, offset, shape);
+    ref.index = shapes.size();
+    shapes.push_back(shape);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      ref.min[axis] = shape.min[axis];
+      ref.max[axis] = shape.max[axis];
+      ref.center[axis] = 0.5 * (shape.min[axis] + shape.max[axis]);
+    }
+    refs.push_back(ref);
+  }
+}
+
+void ScanSimulator::build()
+{
+  nodes.clear();
+  if (refs.empty())
+    return;
+
+  nodes.reserve(2 * refs.size() / LEAF_SIZE + 1);
+  buildNode(0, refs.size(), 0);
+}
+
+unsigned int ScanSimulator::buildNode(size_t begin, size_t end, int depth)
+{
+  const unsigned int index = nodes.size();
+  nodes.push_back(Node());
+
+  Node node;
+  double centerMin[3], centerMax[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    node.min[axis] = centerMin[axis] = HUGE_VAL;
+    node.max[axis] = centerMax[axis] = -HUGE_VAL;
+    for (size_t i = begin; i < end; ++i)
+    {
+      node.min[axis] = std::min(node.min[axis], refs[i].min[axis]);
+      node.max[axis] = std::max(node.max[axis], refs[i].max[axis]);
+      centerMin[axis] = std::min(centerMin[axis], refs[i].center[axis]);
+      centerMax[axis] = std::max(centerMax[axis], refs[i].center[axis]);
+    }
+  }
+
+  if (end - begin <= LEAF_SIZE || depth + 1 >= MAX_DEPTH)
+  {
+    node.first = begin;
+    node.count = end - begin;
+    node.axis = 0;
+    nodes[index] = node;
+    return index;
+  }
+
+  //binned surface area heuristic: of all bin borders along all axes, the split with the least
+  //summed area times primitive count of both sides wins
+  size_t bestCount = 0;
+  double bestCost = HUGE_VAL, bestBorder = 0.0;
+  node.axis = 0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    const double extent = centerMax[axis] - centerMin[axis];
+    if (extent <= 0.0)
+      continue;
+
+    Bin bins[NUM_BINS];
+    for (size_t i = begin; i < end; ++i)
+    {
+      const int bin = std::min<int>(NUM_BINS - 1, (refs[i].center[axis] - centerMin[axis]) / extent * NUM_BINS);
+      bins[bin].add(refs[i].min, refs[i].max);
+    }
+
+    Bin right[NUM_BINS];
+    right[NUM_BINS - 1] = bins[NUM_BINS - 1];
+    for (int b = NUM_BINS - 2; b > 0; --b)
+      right[b] = right[b + 1].merged(bins[b]);
+
+    Bin left;
+    for (int b = 1; b < NUM_BINS; ++b)
+    {
+      left = left.merged(bins[b - 1]);
+      if (left.count == 0 || right[b].count == 0)
+        continue;
+
+      const double cost = left.getArea() * left.count + right[b].getArea() * right[b].count;
+      if (cost < bestCost)
+      {
+        bestCost = cost;
+        bestCount = left.count;
+        bestBorder = centerMin[axis] + extent * b / NUM_BINS;
+        node.axis = axis;
+      }
+    }
+  }
+
+  if (bestCount == 0)
+  {
+    //all centers coincide
+    node.first = begin;
+    node.count = end - begin;
+    nodes[index] = node;
+    return index;
+  }
+
+  const int axis = node.axis;
+  const double border = bestBorder;
+  const size_t middle = std::partition(refs.begin() + begin, refs.begin() + end, [axis, border](const PrimitiveRef &ref)
+  { return ref.center[axis] < border;}) - refs.begin();
+
+  //the first child directly follows its parent
+  buildNode(begin, middle, depth + 1);
+  node.first = buildNode(middle, end, depth + 1);
+  node.count = 0;
+  nodes[index] = node;
+  return index;
+}
+
+size_t ScanSimulator::getNumPrimitives() const
+{
+  return refs.size();
+}
+
+void ScanSimulator::castRays(const double pose[6], const double *directions, size_t numRays, double rangeMin, double rangeMax, float *ranges) const
+{
+  double rotation[3][3];
+  getRotation(pose[3], pose[4], pose[5], rotation);
+
+  double packet[PACKET_SIZE][3], t[PACKET_SIZE];
+  for (size_t first = 0; first < numRays; first += PACKET_SIZE)
+  {
+    const int numPacketRays = std::min<size_t>(PACKET_SIZE, numRays - first);
+    for (int r = 0; r < numPacketRays; ++r)
+    {
+      const double *direction = directions + 3 * (first + r);
+      for (int axis = 0; axis < 3; ++axis)
+        packet[r][axis] = rotation[axis][0] * direction[0] + rotation[axis][1] * direction[1] + rotation[axis][2] * direction[2];
+      t[r] = rangeMax;
+    }
+
+    castPacket(pose, packet, numPacketRays, t);
+
+    for (int r = 0; r < numPacketRays; ++r)
+      ranges[first + r] = t[r] < rangeMax && t[r] >= rangeMin ? t[r] : std::numeric_limits<float>::quiet_NaN();
+  }
+}
+
+void ScanSimulator::castPacket(const double origin[3], const double directions[][3], int numRays, double *t) const
+{
+  if (nodes.empty())
+    return;
+
+  double inverse[PACKET_SIZE][3];
+  for (int r = 0; r < numRays; ++r)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+      inverse[r][axis] = 1.0 / (directions[r][axis] != 0.0 ? directions[r][axis] : 1e-300);
+  }
+
+  unsigned int stack[MAX_DEPTH + 1];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0)
+  {
+    const unsigned int index = stack[--stackSize];
+    const Node &node = nodes[index];
+
+    //all rays of a packet share the origin, so the box is moved into its frame once
+    const double lower[3] = {node.min[0] - origin[0], node.min[1] - origin[1], node.min[2] - origin[2]};
+    const double upper[3] = {node.max[0] - origin[0], node.max[1] - origin[1], node.max[2] - origin[2]};
+    unsigned int active = 0;
+    for (int r = 0; r < numRays; ++r)
+    {
+      double near = 0.0, far = t[r];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        double t0 = lower[axis] * inverse[r][axis], t1 = upper[axis] * inverse[r][axis];
+        if (t0 > t1)
+          std::swap(t0, t1);
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+      }
+      if (near <= far)
+        active |= 1u << r;
+    }
+
+    if (active == 0)
+      continue;
+
+    if (node.count > 0)
+    {
+      for (unsigned int i = node.first; i < node.first + node.count; ++i)
+      {
+        for (int r = 0; r < numRays; ++r)
+        {
+          if (active & (1u << r))
+            intersect(refs[i], origin, directions[r], t[r]);
+        }
+      }
+      continue;
+    }
+
+    //the child nearer to the packet is visited first, so that it shortens the rays for the other
+    if (directions[0][node.axis] < 0.0)
+    {
+      stack[stackSize++] = index + 1;
+      stack[stackSize++] = node.first;
+    }
+    else
+    {
+      stack[stackSize++] = node.first;
+      stack[stackSize++] = index + 1;
+    }
+  }
+}
+
+bool ScanSimulator::intersect(const PrimitiveRef &ref, const double origin[3], const double direction[3], double &t) const
+{
+  switch (ref.kernel)
+  {
+    case 0:
+      return BoxKernel::intersectRay(boxes[ref.index], origin, direction, t);
+    case 1:
+      return SphereKernel::intersectRay(spheres[ref.index], origin, direction, t);
+    case 2:
+      return CylinderKernel::intersectRay(cylinders[ref.index], origin, direction, t);
+    case 3:
+      return PolygonPrismKernel::intersectRay(polygonPrisms[ref.index], origin, direction, t);
+    default:
+      return CapsuleKernel::intersectRay(capsules[ref.index], origin, direction, t);
+  }
+}
+
+bool ScanSimulator::writeScan(const ObjectScan &scan, std::ostream &file, ThreadPool &pool) const
+{
+  std::vector<double> directions;
+  getRayDirections(scan, directions);
+  const size_t numRays = directions.size() / 3, numPoses = scan.poses.size() / 6;
+
+  //every job casts one chunk of packets from one pose
+  const size_t chunkSize = 64 * PACKET_SIZE, chunksPerPose = (numRays + chunkSize - 1) / chunkSize;
+  std::vector<float> ranges(numRays * numPoses);
+  pool.parallelFor(numPoses * chunksPerPose, 4, [&](size_t begin, size_t end, int)
+  {
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+      const size_t pose = chunk / chunksPerPose, first = (chunk % chunksPerPose) * chunkSize;
+      castRays(&scan.poses[6 * pose], &directions[3 * first], std::min(chunkSize, numRays - first), scan.range[0], scan.range[1],
+          &ranges[pose * numRays + first]);
+    }
+  });
+
+  file.write("SWCSCAN1", 8);
+  writeValue<uint32_t>(file, scan.type);
+  writeValue<uint32_t>(file, scan.points ? 1 : 0);
+  writeValue<uint32_t>(file, numPoses);
+  writeValue<uint32_t>(file, numRays);
+  for (size_t i = 0; i < directions.size(); ++i)
+    writeValue<float>(file, directions[i]);
+
+  for (size_t pose = 0; pose < numPoses; ++pose)
+  {
+    for (int i = 0; i < 6; ++i)
+      writeValue<float>(file, scan.poses[6 * pose + i]);
+
+    const float *poseRanges = &ranges[pose * numRays];
+    if (!scan.points)
+    {
+      file.write(reinterpret_cast<const char*>(poseRanges), numRays * sizeof(float));
+      continue;
+    }
+
+    std::vector<float> points;
+    for (size_t i = 0; i < numRays; ++i)
+    {
+      if (std::isnan(poseRanges[i]))
+        continue;
+      for (int axis = 0; axis < 3; ++axis)
+        points.push_back(poseRanges[i] * directions[3 * i + axis]);
+    }
+    writeValue<uint32_t>(file, points.size() / 3);
+    file.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(float));
+  }
+
+  return file.good();
+}
@@ -1,20 +1,333 @@
 #include <simple_world_creator/simple_world_creator.h>
 
+namespace
+{
+//box reduced to the line it lies on: angle, thickness, height, base, normal offset and the lower end along the line
+struct LineBox
+{
+  double values[6];
+  int index;
+};
+
+struct CompareLineBoxes
+{
+  explicit CompareLineBoxes(int value) :
+      value(value)
+  {
+  }
+
+  bool operator()(const LineBox &a, const LineBox &b) const
+  {
+    return a.values[value] < b.values[value];
+  }
+
+  int value;
+};
+
+//copies box i of source to the end of target, with the same interned name
+void copyBox(const BoxColumns &source, size_t i, BoxColumns &target)
+{
+  target.centerX.push_back(source.centerX[i]);
+  target.centerY.push_back(source.centerY[i]);
+  target.bottomZ.push_back(source.bottomZ[i]);
+  target.sizeX.push_back(source.sizeX[i]);
+  target.sizeY.push_back(source.sizeY[i]);
+  target.sizeZ.push_back(source.sizeZ[i]);
+  target.angle.push_back(source.angle[i]);
+  target.name.push_back(source.name[i]);
+}
+
+//box angle folded into [0, pi), as a box turned by pi lies on the same line
+double getLineAngle(double angle, double epsilon)
+{
+  angle = std::fmod(angle, M_PI);
+  if (angle < 0.0)
+    angle += M_PI;
+  if (angle > M_PI - epsilon)
+    angle = 0.0;
+  return angle;
+}
+
+//sets the normal offset and the lower end of a box for a line with the given angle
+void projectLineBox(const BoxColumns &boxes, double angle, LineBox &lineBox)
+{
+  const int i = lineBox.index;
+  lineBox.values[4] = boxes.centerX[i] * cos(angle) + boxes.centerY[i] * sin(angle);
+  lineBox.values[5] = -boxes.centerX[i] * sin(angle) + boxes.centerY[i] * cos(angle) - 0.5 * boxes.sizeY[i];
+}
+
+//splits [begin, end) into groups whose values from the given one up to the normal offset each differ by at most
+//epsilon between neighbours
+void groupLineBoxes(std::vector<LineBox> &lineBoxes, size_t begin, size_t end, int value, double epsilon,
+                    std::vector<std::pair<size_t, size_t> > &groups)
+{
+  if (value == 5)
+  {
+    groups.push_back(std::make_pair(begin, end));
+    return;
+  }
+
+  std::sort(lineBoxes.begin() + begin, lineBoxes.begin() + end, CompareLineBoxes(value));
+  for (size_t i = begin; i < end;)
+  {
+    size_t j = i + 1;
+    for (; j < end && lineBoxes[j].values[value] - lineBoxes[j - 1].values[value] <= epsilon; ++j)
+      ;
+    groupLineBoxes(lineBoxes, i, j, value + 1, epsilon, groups);
+    i = j;
+  }
+}
+
+double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//writes a geometry over several lines, as inside the <geometry> tag of a model
+void writeGazeboGeometry(std::ostream &file, const GazeboGeometry &geometry)
+{
+  file << "            <" << geometry.type << ">" << std::endl;
+  for (size_t i = 0; i < geometry.parameters.size(); ++i)
+    file << "              <" << geometry.parameters[i].first << ">" << geometry.parameters[i].second << "</" << geometry.parameters[i].first << ">"
+        << std::endl;
+  file << "            </" << geometry.type << ">" << std::endl;
+}
+
+std::string getGazeboGeometryLine(const GazeboGeometry &geometry)
+{
+  std::ostringstream line;
+  line << "<" << geometry.type << ">";
+  for (size_t i = 0; i < geometry.parameters.size(); ++i)
+    line << "<" << geometry.parameters[i].first << ">" << geometry.parameters[i].second << "</" << geometry.parameters[i].first << ">";
+  line << "</" << geometry.type << ">";
+  return line.str();
+}
+
+template<typename Kernel>
+void addGazeboBatchCells(const PrimitiveStore &gazeboPrimitives, int kernel, double cellSize,
+                         std::map<std::pair<int, int>, std::vector<std::pair<int, size_t> > > &batches)
+{
+  const typename Kernel::Columns &columns = Kernel::getColumns(gazeboPrimitives);
+  double anchor[2];
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    Kernel::getAnchor(columns, i, anchor);
+    batches[std::make_pair(static_cast<int>(std::floor(anchor[0] / cellSize)), static_cast<int>(std::floor(anchor[1] / cellSize)))].push_back(
+        std::make_pair(kernel, i));
+  }
+}
+
+template<typename Kernel>
+void extendShapeBounds(const PrimitiveStore &store, const double offset[3], double min[3], double max[3])
+{
+  const typename Kernel::Columns &columns = Kernel::getColumns(store);
+  typename Kernel::Shape shape;
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    Kernel::getShape(columns, i, offset, shape);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      min[axis] = std::min(min[axis], shape.min[axis]);
+      max[axis] = std::max(max[axis], shape.max[axis]);
+    }
+  }
+}
+
+//extends the metric bounding box [min, max] by all primitives of the store moved by offset
+void extendPrimitiveBounds(const PrimitiveStore &store, const double offset[3], double min[3], double max[3])
+{
+  extendShapeBounds<BoxKernel>(store, offset, min, max);
+  extendShapeBounds<SphereKernel>(store, offset, min, max);
+  extendShapeBounds<CylinderKernel>(store, offset, min, max);
+  extendShapeBounds<PolygonPrismKernel>(store, offset, min, max);
+  extendShapeBounds<CapsuleKernel>(store, offset, min, max);
+}
+
+template<typename Kernel>
+void addTransformedShapes(const PrimitiveStore &source, const double pose[4], PrimitiveStore &target)
+{
+  typename Kernel::Object object;
+  for (size_t i = 0; i < Kernel::getColumns(source).size(); ++i)
+  {
+    Kernel::getObject(source, i, object);
+    Kernel::transform(object, pose);
+    Kernel::add(target, object);
+  }
+}
+
+//adds all primitives of source to target, rotated by the yaw of an (x, y, z, yaw) pose and then translated
+void addTransformedPrimitives(const PrimitiveStore &source, const double pose[4], PrimitiveStore &target)
+{
+  addTransformedShapes<BoxKernel>(source, pose, target);
+  addTransformedShapes<SphereKernel>(source, pose, target);
+  addTransformedShapes<CylinderKernel>(source, pose, target);
+  addTransformedShapes<PolygonPrismKernel>(source, pose, target);
+  addTransformedShapes<CapsuleKernel>(source, pose, target);
+}
+
+//prints voxelization progress at most every two seconds
+class VoxelizationProgressPrinter
+{
+public:
+  VoxelizationProgressPrinter() :
+      nextPrint(2.0)
+  {
+  }
+
+  void operator()(const VoxelizationProgress &progress)
+  {
+    if (progress.elapsedSeconds < nextPrint || progress.voxelsTotal <= 0.0)
+      return;
+
+    nextPrint = progress.elapsedSeconds + 2.0;
+    ROS_INFO("Voxelizing... %.0f%% (%.1f s elapsed, about %.1f s remaining)", 100.0 * progress.voxelsDone / progress.voxelsTotal,
+             progress.elapsedSeconds, progress.remainingSeconds);
+  }
+
+private:
+  double nextPrint;
+};
+}
+
 WorldCreator::WorldCreator(std::string file)
 {
   octree = NULL;
+  hasColumns = false;
   canCreateOctomap = false;
   canCreateGazebo = false;
   canCreatePNG = false;
   worldName = "";
   resolution = 0.0;
   updateRate = 0.0;
+  frameRate = 10.0;
   addFloor = false;
+  currentPrototype = -1;
+  mergeLineBoxes = false;
+  markFreeSpace = false;
+  batchCellSize = 20.0;
+  voxelizeTimeBudget = 0.0;
+  denseGridMemoryLimit = 256.0;
+  compression = COMPRESSION_NONE;
+  compressionLevel = 0;
+  uncompressedBytes = compressedBytes = 0;
+  verbose = false;
+  numThreads = 0;
   minZ = 0.0;
   maxZ = 5.0;
+  parseSeconds = 0.0;
+  voxelizeSeconds = 0.0;
 
   fileName = file;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
   foundConfig = readConfigFile();
+  parseSeconds = secondsSince(start);
+}
+
+WorldCreator::~WorldCreator()
+{
+  delete octree;
+}
+
+bool WorldCreator::hasFoundConfig() const
+{
+  return foundConfig;
+}
+
+void WorldCreator::swapColumns(ColumnWorld &scratch)
+{
+  //lets batch workers hand their allocated buffers from one world to the next
+  columns.swap(scratch);
+  hasColumns = false;
+}
+
+void WorldCreator::setNumThreads(int numThreads)
+{
+  this->numThreads = numThreads;
+}
+
+bool WorldCreator::createWorldFiles(const std::vector<std::string> &options, bool verbose)
+{
+  bool success = true, stats = false;
+  this->verbose = verbose;
+
+  //settings apply to all outputs, regardless of their position on the command line
+  for (int i = 0; i < options.size(); ++i)
+  {
+    if (options[i] == "--stats")
+      stats = true;
+    else if (options[i].compare(0, 14, "--time_budget=") == 0)
+    {
+      //overrides voxelize_time_budget from the config file
+      std::istringstream iss(options[i].substr(14));
+      iss >> voxelizeTimeBudget;
+    }
+    else if (options[i].compare(0, 11, "--compress=") == 0)
+    {
+      if (!CompressedOutputFile::parseCompression(options[i].substr(11), compression, compressionLevel)
+          || !CompressedOutputFile::isAvailable(compression))
+      {
+        std::cout << "Compression '" << options[i].substr(11) << "' is unknown or was not built in, writing uncompressed files." << std::endl;
+        compression = COMPRESSION_NONE;
+      }
+    }
+  }
+
+  for (int i = 0; i < options.size(); ++i)
+  {
+    const std::string &s = options[i];
+    if (s == "--octomap")
+    {
+      if (verbose)
+        ROS_INFO("Creating octomap...");
+      success = createOctree() && success;
+    }
+    else if (s == "--gazebo")
+    {
+      if (verbose)
+        ROS_INFO("Creating gazebo world file...");
+      success = createGazeboWorldFile() && success;
+    }
+    else if (s == "--gazebo_batched")
+    {
+      if (verbose)
+        ROS_INFO("Creating batched gazebo world file...");
+      success = createGazeboWorldFile(true) && success;
+    }
+    else if(s == "--png")
+    {
+      if (verbose)
+        ROS_INFO("Creating png...");
+      success = createPNG() && success;
+    }
+    else if (s == "--scans")
+    {
+      if (verbose)
+        ROS_INFO("Casting scans...");
+      success = createScans() && success;
+    }
+    else if (s == "--animation")
+    {
+      if (verbose)
+        ROS_INFO("Creating animation...");
+      success = createAnimation() && success;
+    }
+    else if (s == "--stl" || s == "--obj")
+    {
+      if (verbose)
+        ROS_INFO("Creating mesh...");
+      success = createMesh(s == "--obj") && success;
+    }
+    else
+      continue;
+
+    if (verbose)
+      ROS_INFO("Done!");
+  }
+
+  if (stats)
+    printStats();
+
+  return success;
 }
 
 bool WorldCreator::readConfigFile()
@@ -23,6 +336,8 @@ bool WorldCreator::readConfigFile()
   if (!file.good())
     return false;
 
+  reservePrimitives(file);
+
   std::string line;
   std::pair<std::string, std::string> keyValuePair;
   while (std::getline(file, line))
@@ -46,29 +361,109 @@ bool WorldCreator::readConfigFile()
       else
         addFloor = false;
     }
+    else if (keyValuePair.first == "merge_line_boxes" && !keyValuePair.second.empty())
+      mergeLineBoxes = keyValuePair.second == "true";
+    else if (keyValuePair.first == "mark_free_space" && !keyValuePair.second.empty())
+      markFreeSpace = keyValuePair.second == "true";
+    else if (keyValuePair.first == "batch_cell_size" && !keyValuePair.second.empty())
+    {
+      std::istringstream iss(keyValuePair.second);
+      iss >> batchCellSize;
+    }
+    else if (keyValuePair.first == "voxelize_time_budget" && !keyValuePair.second.empty())
+    {
+      std::istringstream iss(keyValuePair.second);
+      iss >> voxelizeTimeBudget;
+    }
+    else if (keyValuePair.first == "dense_grid_memory_limit" && !keyValuePair.second.empty())
+    {
+      std::istringstream iss(keyValuePair.second);
+      iss >> denseGridMemoryLimit;
+    }
+    else if (keyValuePair.first == "frame_rate" && !keyValuePair.second.empty())
+    {
+      std::istringstream iss(keyValuePair.second);
+      iss >> frameRate;
+    }
     else if (keyValuePair.first == "resolution" && !keyValuePair.second.empty())
     {
       std::istringstream iss(keyValuePair.second);
       iss >> resolution;
     }
     else if (keyValuePair.first == "-box" && keyValuePair.second.empty())
-      readBox(file);
+      readShape<BoxKernel>(file);
     else if (keyValuePair.first == "-line_box" && keyValuePair.second.empty())
-      readLineBox(file);
+      readShape<LineBoxKernel>(file);
     else if (keyValuePair.first == "-sphere" && keyValuePair.second.empty())
-      readSphere(file);
+      readShape<SphereKernel>(file);
     else if (keyValuePair.first == "-cylinder" && keyValuePair.second.empty())
-      readCylinder(file);
+      readShape<CylinderKernel>(file);
+    else if (keyValuePair.first == "-polygon_prism" && keyValuePair.second.empty())
+      readShape<PolygonPrismKernel>(file);
+    else if (keyValuePair.first == "-capsule" && keyValuePair.second.empty())
+      readShape<CapsuleKernel>(file);
+    else if (keyValuePair.first == "-prototype" && keyValuePair.second.empty())
+      readPrototype(file);
+    else if (keyValuePair.first == "-end_prototype" && keyValuePair.second.empty())
+      currentPrototype = -1;
+    else if (keyValuePair.first == "-instance" && keyValuePair.second.empty())
+      readInstance(file);
+    else if (keyValuePair.first == "-array" && keyValuePair.second.empty())
+      readArray(file);
+    else if (keyValuePair.first == "-scan" && keyValuePair.second.empty())
+      readScan(file);
+    else if (keyValuePair.first == "-animation" && keyValuePair.second.empty())
+      readAnimation(file);
   }
 
   file.close();
+  primitives.shrinkToFit();
+  for (int i = 0; i < prototypes.size(); ++i)
+    prototypes[i].primitives.shrinkToFit();
 
   return true;
 }
 
+void WorldCreator::reservePrimitives(std::ifstream &file)
+{
+  //counting the primitive headers first is much cheaper than growing the columns while parsing
+  size_t numBoxes = 0, numSpheres = 0, numCylinders = 0, numPolygonPrisms = 0, numCapsules = 0;
+  std::string line;
+  while (file.peek() != std::ifstream::traits_type::eof())
+  {
+    //only headers start with '-', all other lines are skipped without copying them
+    if (file.peek() != '-')
+    {
+      file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+      continue;
+    }
+
+    std::getline(file, line);
+    if (line == "-box" || line == "-line_box")
+      ++numBoxes;
+    else if (line == "-sphere")
+      ++numSpheres;
+    else if (line == "-cylinder")
+      ++numCylinders;
+    else if (line == "-polygon_prism")
+      ++numPolygonPrisms;
+    else if (line == "-capsule")
+      ++numCapsules;
+  }
+  primitives.reserve(numBoxes, numSpheres, numCylinders, numPolygonPrisms, numCapsules);
+
+  file.clear();
+  file.seekg(0);
+}
+
+PrimitiveStore& WorldCreator::getTargetPrimitives()
+{
+  return currentPrototype >= 0 ? prototypes[currentPrototype].primitives : primitives;
+}
+
 void WorldCreator::setCreatePossibilities()
 {
-  if (boxes.size() == 0 && cylinders.size() == 0 && spheres.size() == 0)
+  if (primitives.empty() && instances.empty())
     return;
 
   if (worldName != "" && updateRate != 0.0)
@@ -83,33 +478,75 @@ void WorldCreator::setCreatePossibilities()
 
 void WorldCreator::getKeyValuePair(std::string &str, std::pair<std::string, std::string> &keyValuePair)
 {
-  keyValuePair.first.clear();
+  //everything up to the first ':' is the key, the rest without any further ':' is the value
+  const size_t colon = str.find(':');
+  keyValuePair.first.assign(str, 0, colon);
   keyValuePair.second.clear();
+  if (colon == std::string::npos)
+    return;
+
+  keyValuePair.second.assign(str, colon + 1, std::string::npos);
+  keyValuePair.second.erase(std::remove(keyValuePair.second.begin(), keyValuePair.second.end(), ':'), keyValuePair.second.end());
+}
+
+template<typename Kernel>
+void WorldCreator::readShape(std::ifstream &file)
+{
+  std::string line;
+  std::pair<std::string, std::string> keyValuePair;
 
-  bool readValue = false;
-  for (std::string::iterator it = str.begin(); it != str.end(); ++it)
+  typename Kernel::Object object;
+  unsigned int gotFields = 0;
+
+  while (std::getline(file, line))
   {
-    if (*it == ':')
-    {
-      readValue = true;
+    if (line.empty())
       continue;
-    }
 
-    if (!readValue)
-      keyValuePair.first.push_back(*it);
-    else
-      keyValuePair.second.push_back(*it);
+    getKeyValuePair(line, keyValuePair);
+
+    if (!keyValuePair.second.empty())
+      gotFields |= Kernel::readField(keyValuePair.first, keyValuePair.second, object);
+
+    if (gotFields == Kernel::FIELDS)
+    {
+      Kernel::add(getTargetPrimitives(), object);
+      break;
+    }
   }
+}
+
+void WorldCreator::readPrototype(std::ifstream &file)
+{
+  std::string line;
+  std::pair<std::string, std::string> keyValuePair;
+
+  while (std::getline(file, line))
+  {
+    if (line.empty())
+      continue;
+
+    getKeyValuePair(line, keyValuePair);
 
+    if (keyValuePair.first == "name" && !keyValuePair.second.empty())
+    {
+      //all primitives up to '-end_prototype' belong to this prototype
+      ObjectPrototype prototype;
+      prototype.name = keyValuePair.second;
+      prototypes.push_back(prototype);
+      currentPrototype = prototypes.size() - 1;
+      break;
+    }
+  }
 }
 
-void WorldCreator::readBox(std::ifstream &file)
+void WorldCreator::readInstance(std::ifstream &file)
 {
   std::string line;
   std::pair<std::string, std::string> keyValuePair;
 
-  ObjectBox box;
-  bool gotName = false, gotBottom = false, gotSize = false, gotAngle = false;
+  ObjectInstance instance;
+  bool gotName = false, gotPrototype = false, gotOffset = false;
 
   while (std::getline(file, line))
   {
@@ -120,47 +557,44 @@ void WorldCreator::readBox(std::ifstream &file)
 
     if (keyValuePair.first == "name" && !keyValuePair.second.empty())
     {
-      box.name = keyValuePair.second;
+      instance.name = keyValuePair.second;
       gotName = true;
     }
-    else if (keyValuePair.first == "bottom_center" && !keyValuePair.second.empty())
-    {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> box.bottomCenter[0] >> box.bottomCenter[1] >> box.bottomCenter[2]))
-        continue;
-      gotBottom = true;
-    }
-    else if (keyValuePair.first == "size" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "prototype" && !keyValuePair.second.empty())
     {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> box.size[0] >> box.size[1] >> box.size[2]))
-        continue;
-      gotSize = true;
+      instance.prototype = findPrototype(keyValuePair.second);
+      if (instance.prototype < 0)
+      {
+        ROS_WARN("Unknown prototype '%s'. Prototypes have to be defined before they are instanced.", keyValuePair.second.c_str());
+        return;
+      }
+      gotPrototype = true;
     }
-    else if (keyValuePair.first == "angle" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "offset" && !keyValuePair.second.empty())
     {
       std::istringstream iss(keyValuePair.second);
-      if (!(iss >> box.angle))
+      if (!(iss >> instance.offset[0] >> instance.offset[1] >> instance.offset[2]))
         continue;
-      gotAngle = true;
-      box.angle = box.angle * M_PI / 180.0;
+      gotOffset = true;
     }
 
-    if (gotName && gotBottom && gotSize && gotAngle)
+    if (gotName && gotPrototype && gotOffset)
     {
-      boxes.push_back(box);
+      instances.push_back(instance);
       break;
     }
   }
 }
 
-void WorldCreator::readLineBox(std::ifstream &file)
+void WorldCreator::readArray(std::ifstream &file)
 {
   std::string line;
   std::pair<std::string, std::string> keyValuePair;
 
-  ObjectLineBox lineBox;
-  bool gotName = false, gotStart = false, gotEnd = false, gotHeight = false, gotThickness = false;
+  ObjectInstance origin;
+  double step[3];
+  int count[3];
+  bool gotName = false, gotPrototype = false, gotOffset = false, gotStep = false, gotCount = false;
 
   while (std::getline(file, line))
   {
@@ -171,98 +605,109 @@ void WorldCreator::readLineBox(std::ifstream &file)
 
     if (keyValuePair.first == "name" && !keyValuePair.second.empty())
     {
-      lineBox.name = keyValuePair.second;
+      origin.name = keyValuePair.second;
       gotName = true;
     }
-    else if (keyValuePair.first == "start" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "prototype" && !keyValuePair.second.empty())
     {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> lineBox.start[0] >> lineBox.start[1]))
-        continue;
-      gotStart = true;
+      origin.prototype = findPrototype(keyValuePair.second);
+      if (origin.prototype < 0)
+      {
+        ROS_WARN("Unknown prototype '%s'. Prototypes have to be defined before they are instanced.", keyValuePair.second.c_str());
+        return;
+      }
+      gotPrototype = true;
     }
-    else if (keyValuePair.first == "end" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "offset" && !keyValuePair.second.empty())
     {
       std::istringstream iss(keyValuePair.second);
-      if (!(iss >> lineBox.end[0] >> lineBox.end[1]))
+      if (!(iss >> origin.offset[0] >> origin.offset[1] >> origin.offset[2]))
         continue;
-      gotEnd = true;
+      gotOffset = true;
     }
-    else if (keyValuePair.first == "thickness" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "step" && !keyValuePair.second.empty())
     {
       std::istringstream iss(keyValuePair.second);
-      if (!(iss >> lineBox.thickness))
+      if (!(iss >> step[0] >> step[1] >> step[2]))
         continue;
-      gotThickness = true;
+      gotStep = true;
     }
-    else if (keyValuePair.first == "height" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "count" && !keyValuePair.second.empty())
     {
       std::istringstream iss(keyValuePair.second);
-      if (!(iss >> lineBox.height[0] >> lineBox.height[1]))
+      if (!(iss >> count[0] >> count[1] >> count[2]))
         continue;
-      gotHeight = true;
+      gotCount = true;
     }
 
-    if (gotName && gotStart && gotEnd && gotThickness && gotHeight)
+    if (gotName && gotPrototype && gotOffset && gotStep && gotCount)
     {
-      ObjectBox box;
-      convertLineBoxToBox(lineBox, box);
-      boxes.push_back(box);
+      for (int i = 0; i < count[0]; ++i)
+      {
+        for (int j = 0; j < count[1]; ++j)
+        {
+          for (int k = 0; k < count[2]; ++k)
+          {
+            ObjectInstance instance = origin;
+            std::ostringstream name;
+            name << origin.name << "_" << i << "_" << j << "_" << k;
+            instance.name = name.str();
+            instance.offset[0] += i * step[0];
+            instance.offset[1] += j * step[1];
+            instance.offset[2] += k * step[2];
+            instances.push_back(instance);
+          }
+        }
+      }
       break;
     }
   }
 }
 
-void WorldCreator::readSphere(std::ifstream &file)
+void WorldCreator::readScan(std::ifstream &file)
 {
   std::string line;
   std::pair<std::string, std::string> keyValuePair;
 
-  ObjectSphere sphere;
-  bool gotName = false, gotBottom = false, gotRadius = false;
+  ObjectScan scan;
+  scan.type = SCAN_LASER_2D;
+  unsigned int gotFields = 0;
 
-  while (std::getline(file, line))
+  //the required fields depend on the type, which may come last, so the whole block is read first;
+  //it ends at a blank line or at the next header, which is left to the caller
+  while (true)
   {
-    if (line.empty())
+    const std::streampos lineStart = file.tellg();
+    if (!std::getline(file, line) || line.empty())
+      break;
+    if (line[0] == '#')
       continue;
-
-    getKeyValuePair(line, keyValuePair);
-
-    if (keyValuePair.first == "name" && !keyValuePair.second.empty())
-    {
-      sphere.name = keyValuePair.second;
-      gotName = true;
-    }
-    else if (keyValuePair.first == "bottom" && !keyValuePair.second.empty())
+    if (line[0] == '-')
     {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> sphere.bottom[0] >> sphere.bottom[1] >> sphere.bottom[2]))
-        continue;
-      gotBottom = true;
-    }
-    else if (keyValuePair.first == "radius" && !keyValuePair.second.empty())
-    {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> sphere.radius))
-        continue;
-      gotRadius = true;
-    }
-
-    if (gotName && gotBottom && gotRadius)
-    {
-      spheres.push_back(sphere);
+      file.seekg(lineStart);
       break;
     }
+
+    getKeyValuePair(line, keyValuePair);
+
+    if (!keyValuePair.second.empty())
+      gotFields |= ScanSimulator::readField(keyValuePair.first, keyValuePair.second, scan);
   }
+
+  const unsigned int requiredFields = ScanSimulator::getRequiredFields(scan);
+  if ((gotFields & requiredFields) == requiredFields)
+    scans.push_back(scan);
+  else
+    ROS_WARN("Scan '%s' is missing fields or has invalid values and is skipped.", scan.name.c_str());
 }
 
-void WorldCreator::readCylinder(std::ifstream &file)
+void WorldCreator::readAnimation(std::ifstream &file)
 {
   std::string line;
   std::pair<std::string, std::string> keyValuePair;
 
-  ObjectCylinder cylinder;
-  bool gotName = false, gotBottom = false, gotRadius = false, gotHeight = false;
+  ObjectAnimation animation;
+  bool gotName = false, gotPrototype = false, gotKeyframes = false;
 
   while (std::getline(file, line))
   {
@@ -273,55 +718,58 @@ void WorldCreator::readCylinder(std::ifstream &file)
 
     if (keyValuePair.first == "name" && !keyValuePair.second.empty())
     {
-      cylinder.name = keyValuePair.second;
+      animation.name = keyValuePair.second;
       gotName = true;
     }
-    else if (keyValuePair.first == "bottom" && !keyValuePair.second.empty())
-    {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> cylinder.bottom[0] >> cylinder.bottom[1] >> cylinder.bottom[2]))
-        continue;
-      gotBottom = true;
-    }
-    else if (keyValuePair.first == "radius" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "prototype" && !keyValuePair.second.empty())
     {
-      std::istringstream iss(keyValuePair.second);
-      if (!(iss >> cylinder.radius))
-        continue;
-      gotRadius = true;
+      animation.prototype = findPrototype(keyValuePair.second);
+      if (animation.prototype < 0)
+      {
+        ROS_WARN("Unknown prototype '%s'. Prototypes have to be defined before they are animated.", keyValuePair.second.c_str());
+        return;
+      }
+      gotPrototype = true;
     }
-    else if (keyValuePair.first == "height" && !keyValuePair.second.empty())
+    else if (keyValuePair.first == "keyframes" && !keyValuePair.second.empty())
     {
+      //time x y z yaw per keyframe, yaw in degrees
       std::istringstream iss(keyValuePair.second);
-      if (!(iss >> cylinder.height))
+      animation.keyframes.clear();
+      double number;
+      while (iss >> number)
+        animation.keyframes.push_back(animation.keyframes.size() % 5 == 4 ? number * M_PI / 180.0 : number);
+
+      bool sorted = true;
+      for (size_t i = 5; i < animation.keyframes.size(); i += 5)
+        sorted = sorted && animation.keyframes[i] >= animation.keyframes[i - 5];
+      if (animation.keyframes.empty() || animation.keyframes.size() % 5 != 0 || !sorted)
+      {
+        ROS_WARN("Keyframes need five values each (time x y z yaw) and have to be sorted by time.");
         continue;
-      gotHeight = true;
+      }
+      gotKeyframes = true;
     }
 
-    if (gotName && gotBottom && gotRadius && gotHeight)
+    if (gotName && gotPrototype && gotKeyframes)
     {
-      cylinders.push_back(cylinder);
+      animations.push_back(animation);
       break;
     }
   }
 }
 
-void WorldCreator::convertLineBoxToBox(const ObjectLineBox &lineBox, ObjectBox &box)
+int WorldCreator::findPrototype(const std::string &name) const
 {
-  box.name = lineBox.name;
-
-  box.bottomCenter[0] = 0.5 * (lineBox.start[0] + lineBox.end[0]);
-  box.bottomCenter[1] = 0.5 * (lineBox.start[1] + lineBox.end[1]);
-  box.bottomCenter[2] = lineBox.height[0];
-
-  box.size[0] = lineBox.thickness;
-  box.size[1] = sqrt(pow(lineBox.start[0] - lineBox.end[0], 2) + pow(lineBox.start[1] - lineBox.end[1], 2));
-  box.size[2] = lineBox.height[1] - lineBox.height[0];
-
-  box.angle = atan2(lineBox.end[0] - lineBox.start[0], -lineBox.end[1] + lineBox.start[1]);
+  for (int i = 0; i < prototypes.size(); ++i)
+  {
+    if (prototypes[i].name == name)
+      return i;
+  }
+  return -1;
 }
 
-bool WorldCreator::createGazeboWorldFile()
+bool WorldCreator::createGazeboWorldFile(bool batched)
 {
   if (!canCreateGazebo)
   {
@@ -330,44 +778,141 @@ bool WorldCreator::createGazeboWorldFile()
     return false;
   }
 
-  std::string fileNameGazebo = fileName + ".world";
-  std::ofstream file(fileNameGazebo.c_str());
+  CompressedOutputFile file;
+  if (!openOutputFile(fileName + ".world", file))
+    return false;
   addGazeboHead(file);
 
   if (addFloor)
   {
+    PrimitiveStore floor;
     ObjectBox floorBox;
     floorBox.name = "floor";
-    //floorBox.minimum[0] = floorBox.minimum[1] = -100.0;
-    //floorBox.minimum[2] = -0.1;
-    //floorBox.maximum[0] = floorBox.maximum[1] = 100.0;
-    //floorBox.maximum[2] = 0.0;
-    addGazeboBox(file, floorBox);
+    floorBox.bottomCenter[0] = floorBox.bottomCenter[1] = 0.0;
+    floorBox.bottomCenter[2] = -0.1;
+    floorBox.size[0] = floorBox.size[1] = 200.0;
+    floorBox.size[2] = 0.1;
+    floorBox.angle = 0.0;
+    floor.addBox(floorBox);
+    addGazeboShapes<BoxKernel>(file, floor);
   }
 
-  for (int i = 0; i < boxes.size(); ++i)
-    addGazeboBox(file, boxes[i]);
+  PrimitiveStore mergedPrimitives;
+  if (mergeLineBoxes)
+    mergeCollinearBoxes(primitives, mergedPrimitives);
+  const PrimitiveStore &gazeboPrimitives = mergeLineBoxes ? mergedPrimitives : primitives;
 
-  for (int i = 0; i < spheres.size(); ++i)
-    addGazeboSphere(file, spheres[i]);
-
-  for (int i = 0; i < cylinders.size(); ++i)
-    addGazeboCylinder(file, cylinders[i]);
+  if (batched)
+  {
+    //instances are folded into the batches with their offset applied, otherwise each one would stay a model of its own
+    PrimitiveStore batchPrimitives(gazeboPrimitives);
+    for (int i = 0; i < instances.size(); ++i)
+    {
+      const double pose[4] = {instances[i].offset[0], instances[i].offset[1], instances[i].offset[2], 0.0};
+      addTransformedPrimitives(prototypes[instances[i].prototype].primitives, pose, batchPrimitives);
+    }
+    addGazeboBatches(file, batchPrimitives);
+  }
+  else
+  {
+    addGazeboShapes<BoxKernel>(file, gazeboPrimitives);
+    addGazeboShapes<SphereKernel>(file, gazeboPrimitives);
+    addGazeboShapes<CylinderKernel>(file, gazeboPrimitives);
+    addGazeboShapes<PolygonPrismKernel>(file, gazeboPrimitives);
+    addGazeboShapes<CapsuleKernel>(file, gazeboPrimitives);
+
+    for (int i = 0; i < instances.size(); ++i)
+      addGazeboInstance(file, instances[i]);
+  }
 
   addGazeboTail(file);
+  if (!closeOutputFile(file))
+    return false;
+
+  //model directories stay uncompressed, gazebo looks them up on its model path
+  if (!batched && !instances.empty() && !createGazeboPrototypeModels())
+    return false;
 
   return true;
 }
 
-void WorldCreator::addGazeboHead(std::ofstream &file)
+void WorldCreator::mergeCollinearBoxes(const PrimitiveStore &input, PrimitiveStore &output)
 {
-  file << "<sdf version='1.5'>" << std::endl;
-  file << "  <world name='" << worldName << "'>" << std::endl;
-  file << "    <light name='sun' type='directional'>" << std::endl;
-  file << "      <cast_shadows>1</cast_shadows>" << std::endl;
-  file << "      <pose frame=''>0 0 10 0 -0 0</pose>" << std::endl;
-  file << "      <diffuse>0.8 0.8 0.8 1</diffuse>" << std::endl;
-  file << "      <specular>0.2 0.2 0.2 1</specular>" << std::endl;
+  //boxes with equal thickness, height and base that lie on the same line (along their local y axis) are merged
+  //wherever they touch or overlap; the merged box keeps the name, angle and line of the first box of each run
+  const double epsilon = 1e-6;
+  const BoxColumns &boxes = input.boxes;
+
+  std::vector<LineBox> lineBoxes(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    LineBox &lineBox = lineBoxes[i];
+    lineBox.index = i;
+    lineBox.values[0] = getLineAngle(boxes.angle[i], epsilon);
+    lineBox.values[1] = boxes.sizeX[i];
+    lineBox.values[2] = boxes.sizeZ[i];
+    lineBox.values[3] = boxes.bottomZ[i];
+  }
+
+  //lines are found by tolerance instead of rounding, so nearly equal values never end up in different lines
+  std::vector<std::pair<size_t, size_t> > lines;
+  std::sort(lineBoxes.begin(), lineBoxes.end(), CompareLineBoxes(0));
+  for (size_t i = 0; i < lineBoxes.size();)
+  {
+    size_t j = i + 1;
+    for (; j < lineBoxes.size() && lineBoxes[j].values[0] - lineBoxes[j - 1].values[0] <= epsilon; ++j)
+      ;
+
+    //boxes of one direction are projected with the angle of its first box
+    for (size_t k = i; k < j; ++k)
+      projectLineBox(boxes, lineBoxes[i].values[0], lineBoxes[k]);
+    groupLineBoxes(lineBoxes, i, j, 1, epsilon, lines);
+    i = j;
+  }
+
+  //spheres, cylinders and names are kept, boxes are replaced by the merged set; the merged boxes refer to the
+  //names of the copied arena, as its lookup table is gone after shrinkToFit() and interning again would duplicate them
+  output = input;
+  output.boxes = BoxColumns();
+  for (size_t l = 0; l < lines.size(); ++l)
+  {
+    std::vector<LineBox>::iterator first = lineBoxes.begin() + lines[l].first, last = lineBoxes.begin() + lines[l].second;
+    std::sort(first, last, CompareLineBoxes(5));
+
+    for (std::vector<LineBox>::iterator i = first; i != last;)
+    {
+      copyBox(boxes, i->index, output.boxes);
+      double end = i->values[5] + boxes.sizeY[i->index];
+
+      std::vector<LineBox>::iterator j = i + 1;
+      for (; j != last && j->values[5] <= end + epsilon; ++j)
+        end = std::max(end, j->values[5] + boxes.sizeY[j->index]);
+
+      if (j - i > 1)
+      {
+        //the run is placed on the exact line of its first box, not on the one shared by its direction group
+        LineBox line = *i;
+        projectLineBox(boxes, line.values[0], line);
+        const double start = line.values[5], stop = end + line.values[5] - i->values[5];
+        const double center = 0.5 * (start + stop), angle = line.values[0], offset = line.values[4];
+        output.boxes.centerX.back() = -center * sin(angle) + offset * cos(angle);
+        output.boxes.centerY.back() = center * cos(angle) + offset * sin(angle);
+        output.boxes.sizeY.back() = stop - start;
+      }
+      i = j;
+    }
+  }
+}
+
+void WorldCreator::addGazeboHead(std::ostream &file)
+{
+  file << "<sdf version='1.5'>" << std::endl;
+  file << "  <world name='" << worldName << "'>" << std::endl;
+  file << "    <light name='sun' type='directional'>" << std::endl;
+  file << "      <cast_shadows>1</cast_shadows>" << std::endl;
+  file << "      <pose frame=''>0 0 10 0 -0 0</pose>" << std::endl;
+  file << "      <diffuse>0.8 0.8 0.8 1</diffuse>" << std::endl;
+  file << "      <specular>0.2 0.2 0.2 1</specular>" << std::endl;
   file << "      <attenuation>" << std::endl;
   file << "        <range>1000</range>" << std::endl;
   file << "        <constant>0.9</constant>" << std::endl;
@@ -390,17 +935,32 @@ void WorldCreator::addGazeboHead(std::ofstream &file)
   file << "    </scene>" << std::endl;
 }
 
-void WorldCreator::addGazeboTail(std::ofstream &file)
+void WorldCreator::addGazeboTail(std::ostream &file)
 {
   file << "  </world>" << std::endl;
   file << "</sdf>" << std::endl;
 }
 
-void WorldCreator::addGazeboBox(std::ofstream &file, ObjectBox &box)
+template<typename Kernel>
+void WorldCreator::addGazeboShapes(std::ostream &file, const PrimitiveStore &gazeboPrimitives)
 {
-  file << "    <model name='" << box.name << "'>" << std::endl;
-  file << "      <pose frame=''>" << box.bottomCenter[0] << " " << box.bottomCenter[1] << " " << box.bottomCenter[2] + 0.5 * box.size[2] << " 0 0 " << box.angle
-      << " </pose>" << std::endl;
+  const typename Kernel::Columns &columns = Kernel::getColumns(gazeboPrimitives);
+  std::vector<GazeboGeometry> geometries;
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    geometries.clear();
+    Kernel::getGazeboGeometries(columns, i, geometries);
+    addGazeboModel(file, gazeboPrimitives.names.get(columns.name[i]), geometries);
+  }
+}
+
+void WorldCreator::addGazeboModel(std::ostream &file, const std::string &name, const std::vector<GazeboGeometry> &geometries)
+{
+  //a single geometry is placed by the model pose, the parts of compound shapes by their own poses
+  const bool compound = geometries.size() > 1;
+
+  file << "    <model name='" << name << "'>" << std::endl;
+  file << "      <pose frame=''>" << (compound ? std::string("0 0 0 0 0 0") : geometries[0].pose) << "</pose>" << std::endl;
   file << "      <static>1</static>" << std::endl;
   file << "      <link name='link'>" << std::endl;
   file << "        <inertial>" << std::endl;
@@ -414,36 +974,45 @@ void WorldCreator::addGazeboBox(std::ofstream &file, ObjectBox &box)
   file << "            <izz>1</izz>" << std::endl;
   file << "          </inertia>" << std::endl;
   file << "        </inertial>" << std::endl;
-  file << "        <collision name='collision'>" << std::endl;
-  file << "          <geometry>" << std::endl;
-  file << "            <box>" << std::endl;
-  file << "              <size>" << box.size[0] << " " << box.size[1] << " " << box.size[2] << "</size>" << std::endl;
-  file << "            </box>" << std::endl;
-  file << "          </geometry>" << std::endl;
-  file << "          <max_contacts>10</max_contacts>" << std::endl;
-  file << "          <surface>" << std::endl;
-  file << "            <contact>" << std::endl;
-  file << "              <ode/>" << std::endl;
-  file << "            </contact>" << std::endl;
-  file << "            <bounce/>" << std::endl;
-  file << "            <friction>" << std::endl;
-  file << "              <ode/>" << std::endl;
-  file << "            </friction>" << std::endl;
-  file << "          </surface>" << std::endl;
-  file << "        </collision>" << std::endl;
-  file << "        <visual name='visual'>" << std::endl;
-  file << "          <geometry>" << std::endl;
-  file << "            <box>" << std::endl;
-  file << "              <size>" << box.size[0] << " " << box.size[1] << " " << box.size[2] << "</size>" << std::endl;
-  file << "            </box>" << std::endl;
-  file << "          </geometry>" << std::endl;
-  file << "          <material>" << std::endl;
-  file << "            <script>" << std::endl;
-  file << "              <uri>file://media/materials/scripts/gazebo.material</uri>" << std::endl;
-  file << "              <name>Gazebo/Grey</name>" << std::endl;
-  file << "            </script>" << std::endl;
-  file << "          </material>" << std::endl;
-  file << "        </visual>" << std::endl;
+
+  for (int i = 0; i < geometries.size(); ++i)
+  {
+    std::ostringstream suffix;
+    if (compound)
+      suffix << "_" << i;
+
+    file << "        <collision name='collision" << suffix.str() << "'>" << std::endl;
+    if (compound)
+      file << "          <pose frame=''>" << geometries[i].pose << "</pose>" << std::endl;
+    file << "          <geometry>" << std::endl;
+    writeGazeboGeometry(file, geometries[i]);
+    file << "          </geometry>" << std::endl;
+    file << "          <max_contacts>10</max_contacts>" << std::endl;
+    file << "          <surface>" << std::endl;
+    file << "            <contact>" << std::endl;
+    file << "              <ode/>" << std::endl;
+    file << "            </contact>" << std::endl;
+    file << "            <bounce/>" << std::endl;
+    file << "            <friction>" << std::endl;
+    file << "              <ode/>" << std::endl;
+    file << "            </friction>" << std::endl;
+    file << "          </surface>" << std::endl;
+    file << "        </collision>" << std::endl;
+    file << "        <visual name='visual" << suffix.str() << "'>" << std::endl;
+    if (compound)
+      file << "          <pose frame=''>" << geometries[i].pose << "</pose>" << std::endl;
+    file << "          <geometry>" << std::endl;
+    writeGazeboGeometry(file, geometries[i]);
+    file << "          </geometry>" << std::endl;
+    file << "          <material>" << std::endl;
+    file << "            <script>" << std::endl;
+    file << "              <uri>file://media/materials/scripts/gazebo.material</uri>" << std::endl;
+    file << "              <name>Gazebo/Grey</name>" << std::endl;
+    file << "            </script>" << std::endl;
+    file << "          </material>" << std::endl;
+    file << "        </visual>" << std::endl;
+  }
+
   file << "        <self_collide>0</self_collide>" << std::endl;
   file << "        <kinematic>0</kinematic>" << std::endl;
   file << "        <gravity>0</gravity>" << std::endl;
@@ -451,45 +1020,76 @@ void WorldCreator::addGazeboBox(std::ofstream &file, ObjectBox &box)
   file << "    </model>" << std::endl;
 }
 
-void WorldCreator::addGazeboSphere(std::ofstream &file, ObjectSphere &sphere)
+void WorldCreator::addGazeboBatches(std::ostream &file, const PrimitiveStore &gazeboPrimitives)
 {
-  file << "    <model name='" << sphere.name << "'>" << std::endl;
-  file << "      <pose frame=''>" << sphere.bottom[0] << " " << sphere.bottom[1] << " " << sphere.bottom[2] + sphere.radius << " 0 0 0</pose>" << std::endl;
-  file << "      <static>1</static>" << std::endl;
-  file << "      <link name='link'>" << std::endl;
-  file << "        <inertial>" << std::endl;
-  file << "          <mass>1</mass>" << std::endl;
-  file << "          <inertia>" << std::endl;
-  file << "            <ixx>1</ixx>" << std::endl;
-  file << "            <ixy>0</ixy>" << std::endl;
-  file << "            <ixz>0</ixz>" << std::endl;
-  file << "            <iyy>1</iyy>" << std::endl;
-  file << "            <iyz>0</iyz>" << std::endl;
-  file << "            <izz>1</izz>" << std::endl;
-  file << "          </inertia>" << std::endl;
-  file << "        </inertial>" << std::endl;
-  file << "        <collision name='collision'>" << std::endl;
+  //primitives are clustered on a grid of batchCellSize, each cell becomes one static model with a single link
+  typedef std::pair<int, int> BatchCell;
+  typedef std::pair<int, size_t> BatchElement; //(shape kernel, index), see addGazeboBatchCells()
+  std::map<BatchCell, std::vector<BatchElement> > batches;
+
+  const double cellSize = batchCellSize > 0.0 ? batchCellSize : HUGE_VAL;
+  addGazeboBatchCells<BoxKernel>(gazeboPrimitives, 0, cellSize, batches);
+  addGazeboBatchCells<SphereKernel>(gazeboPrimitives, 1, cellSize, batches);
+  addGazeboBatchCells<CylinderKernel>(gazeboPrimitives, 2, cellSize, batches);
+  addGazeboBatchCells<PolygonPrismKernel>(gazeboPrimitives, 3, cellSize, batches);
+  addGazeboBatchCells<CapsuleKernel>(gazeboPrimitives, 4, cellSize, batches);
+
+  int batchId = 0, elementId = 0;
+  for (std::map<BatchCell, std::vector<BatchElement> >::iterator it = batches.begin(); it != batches.end(); ++it, ++batchId)
+  {
+    file << "    <model name='static_batch_" << batchId << "'>" << std::endl;
+    file << "      <pose frame=''>0 0 0 0 0 0</pose>" << std::endl;
+    file << "      <static>1</static>" << std::endl;
+    file << "      <link name='link'>" << std::endl;
+
+    for (int i = 0; i < it->second.size(); ++i)
+    {
+      const BatchElement &element = it->second[i];
+      if (element.first == 0)
+        addGazeboBatchShape<BoxKernel>(file, gazeboPrimitives, element.second, elementId);
+      else if (element.first == 1)
+        addGazeboBatchShape<SphereKernel>(file, gazeboPrimitives, element.second, elementId);
+      else if (element.first == 2)
+        addGazeboBatchShape<CylinderKernel>(file, gazeboPrimitives, element.second, elementId);
+      else if (element.first == 3)
+        addGazeboBatchShape<PolygonPrismKernel>(file, gazeboPrimitives, element.second, elementId);
+      else
+        addGazeboBatchShape<CapsuleKernel>(file, gazeboPrimitives, element.second, elementId);
+    }
+
+    file << "        <self_collide>0</self_collide>" << std::endl;
+    file << "        <kinematic>0</kinematic>" << std::endl;
+    file << "        <gravity>0</gravity>" << std::endl;
+    file << "      </link>" << std::endl;
+    file << "    </model>" << std::endl;
+  }
+
+  if (verbose)
+    ROS_INFO("Batched %d primitives into %d static models.", elementId, batchId);
+}
+
+template<typename Kernel>
+void WorldCreator::addGazeboBatchShape(std::ostream &file, const PrimitiveStore &gazeboPrimitives, size_t i, int &id)
+{
+  const typename Kernel::Columns &columns = Kernel::getColumns(gazeboPrimitives);
+  std::vector<GazeboGeometry> geometries;
+  Kernel::getGazeboGeometries(columns, i, geometries);
+  for (int g = 0; g < geometries.size(); ++g)
+    addGazeboBatchElement(file, gazeboPrimitives.names.get(columns.name[i]), id++, geometries[g].pose, getGazeboGeometryLine(geometries[g]));
+}
+
+void WorldCreator::addGazeboBatchElement(std::ostream &file, const std::string &name, int id, const std::string &pose, const std::string &geometry)
+{
+  file << "        <collision name='" << name << "_" << id << "_collision'>" << std::endl;
+  file << "          <pose frame=''>" << pose << "</pose>" << std::endl;
   file << "          <geometry>" << std::endl;
-  file << "            <sphere>" << std::endl;
-  file << "              <radius>" << sphere.radius << "</radius>" << std::endl;
-  file << "            </sphere>" << std::endl;
+  file << "            " << geometry << std::endl;
   file << "          </geometry>" << std::endl;
-  file << "          <max_contacts>10</max_contacts>" << std::endl;
-  file << "          <surface>" << std::endl;
-  file << "            <contact>" << std::endl;
-  file << "              <ode/>" << std::endl;
-  file << "            </contact>" << std::endl;
-  file << "            <bounce/>" << std::endl;
-  file << "            <friction>" << std::endl;
-  file << "              <ode/>" << std::endl;
-  file << "            </friction>" << std::endl;
-  file << "          </surface>" << std::endl;
   file << "        </collision>" << std::endl;
-  file << "        <visual name='visual'>" << std::endl;
+  file << "        <visual name='" << name << "_" << id << "_visual'>" << std::endl;
+  file << "          <pose frame=''>" << pose << "</pose>" << std::endl;
   file << "          <geometry>" << std::endl;
-  file << "            <sphere>" << std::endl;
-  file << "              <radius>" << sphere.radius << "</radius>" << std::endl;
-  file << "            </sphere>" << std::endl;
+  file << "            " << geometry << std::endl;
   file << "          </geometry>" << std::endl;
   file << "          <material>" << std::endl;
   file << "            <script>" << std::endl;
@@ -498,221 +1098,529 @@ void WorldCreator::addGazeboSphere(std::ofstream &file, ObjectSphere &sphere)
   file << "            </script>" << std::endl;
   file << "          </material>" << std::endl;
   file << "        </visual>" << std::endl;
-  file << "        <self_collide>0</self_collide>" << std::endl;
-  file << "        <kinematic>0</kinematic>" << std::endl;
-  file << "        <gravity>0</gravity>" << std::endl;
-  file << "      </link>" << std::endl;
-  file << "    </model>" << std::endl;
 }
 
-void WorldCreator::addGazeboCylinder(std::ofstream &file, ObjectCylinder &cylinder)
+bool WorldCreator::createGazeboPrototypeModels()
 {
-  file << "    <model name='" << cylinder.name << "'>" << std::endl;
-  file << "      <pose frame=''>" << cylinder.bottom[0] << " " << cylinder.bottom[1] << " " << cylinder.bottom[2] + 0.5 * cylinder.height << " 0 0 0</pose>"
-      << std::endl;
+  //every prototype is written once as a gazebo model that all its instances include
+  const std::string modelPath = fileName + "_models";
+  mkdir(modelPath.c_str(), 0755);
+
+  for (int p = 0; p < prototypes.size(); ++p)
+  {
+    const ObjectPrototype &prototype = prototypes[p];
+    const std::string modelDirectory = modelPath + "/" + prototype.name;
+    mkdir(modelDirectory.c_str(), 0755);
+
+    std::string fileNameConfig = modelDirectory + "/model.config";
+    std::ofstream config(fileNameConfig.c_str());
+    config << "<?xml version='1.0'?>" << std::endl;
+    config << "<model>" << std::endl;
+    config << "  <name>" << prototype.name << "</name>" << std::endl;
+    config << "  <version>1.0</version>" << std::endl;
+    config << "  <sdf version='1.5'>model.sdf</sdf>" << std::endl;
+    config << "  <description>Prototype created by simple_world_creator.</description>" << std::endl;
+    config << "</model>" << std::endl;
+
+    std::string fileNameModel = modelDirectory + "/model.sdf";
+    std::ofstream file(fileNameModel.c_str());
+    if (!file.good() || !config.good())
+    {
+      std::cout << "Cannot write gazebo model '" << modelDirectory << "'." << std::endl;
+      return false;
+    }
+
+    file << "<sdf version='1.5'>" << std::endl;
+    file << "    <model name='" << prototype.name << "'>" << std::endl;
+    file << "      <static>1</static>" << std::endl;
+    file << "      <link name='link'>" << std::endl;
+
+    int elementId = 0;
+    const PrimitiveStore &store = prototype.primitives;
+    for (size_t i = 0; i < store.boxes.size(); ++i)
+      addGazeboBatchShape<BoxKernel>(file, store, i, elementId);
+    for (size_t i = 0; i < store.spheres.size(); ++i)
+      addGazeboBatchShape<SphereKernel>(file, store, i, elementId);
+    for (size_t i = 0; i < store.cylinders.size(); ++i)
+      addGazeboBatchShape<CylinderKernel>(file, store, i, elementId);
+    for (size_t i = 0; i < store.polygonPrisms.size(); ++i)
+      addGazeboBatchShape<PolygonPrismKernel>(file, store, i, elementId);
+    for (size_t i = 0; i < store.capsules.size(); ++i)
+      addGazeboBatchShape<CapsuleKernel>(file, store, i, elementId);
+
+    file << "      </link>" << std::endl;
+    file << "    </model>" << std::endl;
+    file << "</sdf>" << std::endl;
+  }
+
+  ROS_INFO("Add '%s' to GAZEBO_MODEL_PATH to load the instanced models.", modelPath.c_str());
+  return true;
+}
+
+void WorldCreator::addGazeboInstance(std::ostream &file, const ObjectInstance &instance)
+{
+  file << "    <include>" << std::endl;
+  file << "      <uri>model://" << prototypes[instance.prototype].name << "</uri>" << std::endl;
+  file << "      <name>" << instance.name << "</name>" << std::endl;
+  file << "      <pose frame=''>" << instance.offset[0] << " " << instance.offset[1] << " " << instance.offset[2] << " 0 0 0</pose>" << std::endl;
   file << "      <static>1</static>" << std::endl;
-  file << "      <link name='link'>" << std::endl;
-  file << "        <inertial>" << std::endl;
-  file << "          <mass>1</mass>" << std::endl;
-  file << "          <inertia>" << std::endl;
-  file << "            <ixx>1</ixx>" << std::endl;
-  file << "            <ixy>0</ixy>" << std::endl;
-  file << "            <ixz>0</ixz>" << std::endl;
-  file << "            <iyy>1</iyy>" << std::endl;
-  file << "            <iyz>0</iyz>" << std::endl;
-  file << "            <izz>1</izz>" << std::endl;
-  file << "          </inertia>" << std::endl;
-  file << "        </inertial>" << std::endl;
-  file << "        <collision name='collision'>" << std::endl;
-  file << "          <geometry>" << std::endl;
-  file << "            <cylinder>" << std::endl;
-  file << "              <radius>" << cylinder.radius << "</radius>" << std::endl;
-  file << "              <length>" << cylinder.height << "</length>" << std::endl;
-  file << "            </cylinder>" << std::endl;
-  file << "          </geometry>" << std::endl;
-  file << "          <max_contacts>10</max_contacts>" << std::endl;
-  file << "          <surface>" << std::endl;
-  file << "            <contact>" << std::endl;
-  file << "              <ode/>" << std::endl;
-  file << "            </contact>" << std::endl;
-  file << "            <bounce/>" << std::endl;
-  file << "            <friction>" << std::endl;
-  file << "              <ode/>" << std::endl;
-  file << "            </friction>" << std::endl;
-  file << "          </surface>" << std::endl;
-  file << "        </collision>" << std::endl;
-  file << "        <visual name='visual'>" << std::endl;
-  file << "          <geometry>" << std::endl;
-  file << "            <cylinder>" << std::endl;
-  file << "              <radius>" << cylinder.radius << "</radius>" << std::endl;
-  file << "              <length>" << cylinder.height << "</length>" << std::endl;
-  file << "            </cylinder>" << std::endl;
-  file << "          </geometry>" << std::endl;
-  file << "          <material>" << std::endl;
-  file << "            <script>" << std::endl;
-  file << "              <uri>file://media/materials/scripts/gazebo.material</uri>" << std::endl;
-  file << "              <name>Gazebo/Grey</name>" << std::endl;
-  file << "            </script>" << std::endl;
-  file << "          </material>" << std::endl;
-  file << "        </visual>" << std::endl;
-  file << "        <self_collide>0</self_collide>" << std::endl;
-  file << "        <kinematic>0</kinematic>" << std::endl;
-  file << "        <gravity>0</gravity>" << std::endl;
-  file << "      </link>" << std::endl;
-  file << "    </model>" << std::endl;
+  file << "    </include>" << std::endl;
 }
 
-bool WorldCreator::createOctree()
+bool WorldCreator::createColumnWorld()
 {
-  if (!canCreateOctomap)
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  columns.reset(resolution);
+  reserveDenseColumns();
+  hasColumns = false;
+
+  const double origin[3] = {0.0, 0.0, 0.0};
+  VoxelizationQueue queue;
+  queue.setTimeBudget(voxelizeTimeBudget);
+  if (verbose)
+    queue.setProgressCallback(VoxelizationProgressPrinter());
+
+  queue.addPrimitives(columns, primitives, origin);
+
+  std::vector<ColumnWorld> prototypeColumns(prototypes.size());
+  queueColumnInstances(queue, prototypeColumns);
+
+  PrimitiveStore floor;
+  if (addFloor)
+    queueFloor(queue, floor);
+
+  if (!queue.run())
   {
-    std::cout << "Cannot create octree files, because not all necessary parameters have been set. Need 'resolution' and at least one object." << std::endl;
+    if (queue.isTimeBudgetExceeded())
+      std::cout << "Voxelization exceeded the time budget of " << voxelizeTimeBudget << " s and was aborted." << std::endl;
+    else
+      std::cout << "Voxelization was cancelled." << std::endl;
+    columns.reset(resolution);
     return false;
   }
 
-  octree = new octomap::OcTree(resolution);
+  columns.compact();
+  if (columns.empty())
+    return false;
+
+  minX = columns.getMinCoord(0);
+  minY = columns.getMinCoord(1);
+  maxX = columns.getMaxCoord(0);
+  maxY = columns.getMaxCoord(1);
 
-  for (int i = 0; i < boxes.size(); ++i)
+  hasColumns = true;
+  voxelizeSeconds = secondsSince(start);
+  return true;
+}
+
+void WorldCreator::reserveDenseColumns()
+{
+  //bounded worlds are voxelized into a dense bit grid if it fits into dense_grid_memory_limit (MB)
+  if (denseGridMemoryLimit <= 0.0)
+    return;
+
+  double min[3], max[3];
+  if (!getPrimitiveBounds(min, max))
+    return;
+
+  if (addFloor)
+    min[2] = std::min(min[2], minZ - resolution);
+
+  //one key of margin absorbs rounding of stamped instance offsets
+  octomap::key_type minKey[3], maxKey[3];
+  for (int axis = 0; axis < 3; ++axis)
   {
-    addOctreeBox(*octree, boxes[i]);
-    if (!ros::ok())
-    {
-      puts("Terminated. No octomap created!\n");
-      return false;
-    }
+    minKey[axis] = std::max(static_cast<int>(columns.coordToKey(min[axis])) - 1, 0);
+    maxKey[axis] = std::min(static_cast<int>(columns.coordToKey(max[axis])) + 1, ColumnWorld::KEY_LIMIT - 1);
+  }
+
+  if (DenseGrid::getMemoryUsage(minKey, maxKey) <= denseGridMemoryLimit * 1024.0 * 1024.0)
+    columns.reserveDense(minKey, maxKey);
+}
+
+bool WorldCreator::getPrimitiveBounds(double min[3], double max[3]) const
+{
+  //metric bounding box of all primitives and instances, known before anything is voxelized
+  const double origin[3] = {0.0, 0.0, 0.0};
+  std::fill(min, min + 3, HUGE_VAL);
+  std::fill(max, max + 3, -HUGE_VAL);
+  extendPrimitiveBounds(primitives, origin, min, max);
+
+  for (int i = 0; i < instances.size(); ++i)
+    extendPrimitiveBounds(prototypes[instances[i].prototype].primitives, instances[i].offset, min, max);
+
+  return min[0] <= max[0] && min[1] <= max[1] && min[2] <= max[2];
+}
+
+void WorldCreator::queueFloor(VoxelizationQueue &queue, PrimitiveStore &floor)
+{
+  //the floor covers the voxels of the world rectangle one voxel below minZ; it is queued as a large
+  //box, so that it is cut into slabs that report progress and can be cancelled like any primitive
+  double min[3], max[3];
+  int xBegin, xEnd, yBegin, yEnd;
+  if (!getPrimitiveBounds(min, max) || !columns.coordsToKeySpan(min[0], max[0], xBegin, xEnd)
+      || !columns.coordsToKeySpan(min[1], max[1], yBegin, yEnd))
+    return;
+
+  ObjectBox box;
+  box.name = "floor";
+  box.bottomCenter[0] = 0.5 * (columns.keyToBoundaryCoord(xBegin) + columns.keyToBoundaryCoord(xEnd));
+  box.bottomCenter[1] = 0.5 * (columns.keyToBoundaryCoord(yBegin) + columns.keyToBoundaryCoord(yEnd));
+  box.bottomCenter[2] = minZ - resolution;
+  box.size[0] = (xEnd - xBegin) * resolution;
+  box.size[1] = (yEnd - yBegin) * resolution;
+  box.size[2] = resolution;
+  box.angle = 0.0;
+  floor.addBox(box);
+
+  const double origin[3] = {0.0, 0.0, 0.0};
+  queue.addPrimitives(columns, floor, origin);
+}
+
+bool WorldCreator::getKeyOffset(const double offset[3], int keyOffset[3]) const
+{
+  bool aligned = true;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    const double steps = offset[axis] / resolution;
+    keyOffset[axis] = static_cast<int>(std::floor(steps + 0.5));
+    aligned = aligned && std::abs(steps - keyOffset[axis]) < 1e-6;
   }
+  return aligned;
+}
+
+void WorldCreator::queueColumnInstances(VoxelizationQueue &queue, std::vector<ColumnWorld> &prototypeColumns)
+{
+  //prototypes are voxelized once at the origin and stamped by key translation wherever the
+  //instance offset is a multiple of the resolution; other instances are rasterized in place
+  const double origin[3] = {0.0, 0.0, 0.0};
+  std::vector<bool> queuedPrototypes(prototypes.size(), false);
+  std::vector<double> prototypeVoxels(prototypes.size(), 0.0);
 
-  for (int i = 0; i < spheres.size(); ++i)
+  for (int i = 0; i < instances.size(); ++i)
   {
-    addOctreeSphere(*octree, spheres[i]);
-    if (!ros::ok())
+    const ObjectInstance &instance = instances[i];
+    const ObjectPrototype &prototype = prototypes[instance.prototype];
+
+    int keyOffset[3];
+    if (!getKeyOffset(instance.offset, keyOffset))
+      queue.addPrimitives(columns, prototype.primitives, instance.offset);
+    else if (!queuedPrototypes[instance.prototype])
     {
-      puts("Terminated. No octomap created!\n");
-      return false;
+      const double queuedVoxels = queue.getEstimatedVoxels();
+      prototypeColumns[instance.prototype].reset(resolution);
+      queue.addPrimitives(prototypeColumns[instance.prototype], prototype.primitives, origin);
+      queuedPrototypes[instance.prototype] = true;
+      prototypeVoxels[instance.prototype] = queue.getEstimatedVoxels() - queuedVoxels;
     }
   }
 
-  for (int i = 0; i < cylinders.size(); ++i)
+  //stamps run after all prototype jobs, as tasks of the same queue, so that they count for progress, cancellation and the budget
+  for (int i = 0; i < instances.size(); ++i)
   {
-    addOctreeCylinder(*octree, cylinders[i]);
-    if (!ros::ok())
+    int keyOffset[3];
+    if (!getKeyOffset(instances[i].offset, keyOffset))
+      continue;
+
+    ColumnWorld *prototypeWorld = &prototypeColumns[instances[i].prototype];
+    ColumnWorld *world = &columns;
+    queue.addTask([prototypeWorld, world, keyOffset]()
     {
-      puts("Terminated. No octomap created!\n");
-      return false;
-    }
+      //compacting is a no-op after the first stamp of a prototype
+      prototypeWorld->compact();
+      world->stamp(*prototypeWorld, keyOffset[0], keyOffset[1], keyOffset[2]);
+    }, prototypeVoxels[instances[i].prototype]);
   }
+}
 
-  double dummy;
-  octree->getMetricMin(minX, minY, dummy);
-  octree->getMetricMax(maxX, maxY, dummy);
+bool WorldCreator::createAnimation()
+{
+  if (!canCreateOctomap)
+  {
+    std::cout << "Cannot create animation, because not all necessary parameters have been set. Need 'resolution' and at least one object." << std::endl;
+    return false;
+  }
 
-  if(addFloor)
+  if (animations.empty() || frameRate <= 0.0)
   {
-    ObjectBox box;
-    box.angle = 0.0;
-    box.name = "floor";
-    box.size[0] = maxX - minX;
-    box.size[1] = maxY - minY;
-    box.size[2] = resolution;
-    box.bottomCenter[0] = (maxX + minX)*0.5;
-    box.bottomCenter[1] = (maxY + minY)*0.5;
-    box.bottomCenter[2] = minZ - resolution;
-    addOctreeBox(*octree, box);
-    if (!ros::ok())
-    {
-      puts("Terminated. No octomap created!\n");
+    std::cout << "Cannot create animation, because there is no '-animation' block or 'frame_rate' is not positive." << std::endl;
+    return false;
+  }
+
+  //the static world is voxelized once, frames only rasterize the animated objects
+  if (!hasColumns && !createColumnWorld())
+  {
+    puts("Terminated. No animation created!\n");
+    return false;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<ColumnWorld> prototypeColumns(prototypes.size());
+  if (!voxelizeAnimatedPrototypes(prototypeColumns))
+    return false;
+
+  double duration = 0.0;
+  for (int i = 0; i < animations.size(); ++i)
+    duration = std::max(duration, animations[i].keyframes[animations[i].keyframes.size() - 5]);
+  const int numFrames = static_cast<int>(std::floor(duration * frameRate + 1e-9)) + 1;
+
+  ColumnWorld previous, current;
+  AnimationDelta delta;
+  size_t numDeltaRuns = 0;
+
+  for (int frame = 0; frame < numFrames; ++frame)
+  {
+    const double time = frame / frameRate;
+    if (!addAnimatedObjects(time, prototypeColumns, current))
       return false;
+
+    if (frame == 0)
+    {
+      //the base tree holds the static world and the first frame, deltas start at frame 1
+      ColumnWorld base;
+      base.reset(resolution);
+      base.merge(columns);
+      base.merge(current);
+
+      BulkOcTree baseOctree(resolution);
+      baseOctree.insertColumns(base, markFreeSpace);
+
+      CompressedOutputFile file;
+      if (!openOutputFile(fileName + "_animation.bt", file))
+        return false;
+      baseOctree.writeBinary(file);
+      if (!closeOutputFile(file))
+        return false;
     }
+    else
+    {
+      delta.compute(previous, current, columns);
+      numDeltaRuns += delta.getNumAddedRuns() + delta.getNumRemovedRuns();
+
+      std::ostringstream deltaFileName;
+      deltaFileName << fileName << "_animation_" << std::setw(4) << std::setfill('0') << frame << ".delta";
+      CompressedOutputFile file;
+      if (!openOutputFile(deltaFileName.str(), file))
+        return false;
+      delta.write(file, frame, time);
+      if (!closeOutputFile(file))
+        return false;
+    }
+
+    previous.swap(current);
+    if (!ros::ok())
+      return false;
   }
 
-  octree->prune();
+  ROS_INFO("Wrote %d frames of %zu animated objects, %.1f changed runs per frame (%.2f ms per frame).", numFrames, animations.size(),
+           numFrames > 1 ? static_cast<double>(numDeltaRuns) / (numFrames - 1) : 0.0, 1000.0 * secondsSince(start) / numFrames);
+  return true;
+}
+
+bool WorldCreator::voxelizeAnimatedPrototypes(std::vector<ColumnWorld> &prototypeColumns)
+{
+  //frames that only translate a prototype by whole keys stamp its voxelization at the origin
+  const double origin[3] = {0.0, 0.0, 0.0};
+  VoxelizationQueue queue;
+  queue.setTimeBudget(voxelizeTimeBudget);
+  std::vector<bool> queuedPrototypes(prototypes.size(), false);
+
+  for (int i = 0; i < animations.size(); ++i)
+  {
+    const int prototype = animations[i].prototype;
+    if (queuedPrototypes[prototype])
+      continue;
+
+    prototypeColumns[prototype].reset(resolution);
+    queue.addPrimitives(prototypeColumns[prototype], prototypes[prototype].primitives, origin);
+    queuedPrototypes[prototype] = true;
+  }
+
+  if (!queue.run())
+    return false;
 
-  freopen("/dev/null", "w", stderr);
-  octree->writeBinary(fileName + ".bt");
-  octree->write(fileName + ".ot");
+  for (int i = 0; i < prototypeColumns.size(); ++i)
+    prototypeColumns[i].compact();
   return true;
 }
 
-void WorldCreator::addOctreeBox(octomap::OcTree &octree, ObjectBox &box)
+void WorldCreator::getAnimationPose(const ObjectAnimation &animation, double time, double pose[4]) const
 {
-  double minPoint[3], maxPoint[3];
-  const double sizeMax = 0.5 * std::max(box.size[0], box.size[1]);
+  //poses are held before the first and after the last keyframe
+  const std::vector<double> &keyframes = animation.keyframes;
+  size_t next = 0;
+  while (next < keyframes.size() && keyframes[next] <= time)
+    next += 5;
 
-  minPoint[0] = resolution * (std::floor((box.bottomCenter[0] - sizeMax) / resolution)) + resolution * 0.49;
-  minPoint[1] = resolution * (std::floor((box.bottomCenter[1] - sizeMax) / resolution)) + resolution * 0.49;
-  minPoint[2] = resolution * (std::floor(box.bottomCenter[2] / resolution)) + resolution * 0.49;
+  if (next == 0 || next == keyframes.size())
+  {
+    const size_t keyframe = next == 0 ? 0 : next - 5;
+    std::copy(keyframes.begin() + keyframe + 1, keyframes.begin() + keyframe + 5, pose);
+    return;
+  }
 
-  maxPoint[0] = resolution * (std::ceil((box.bottomCenter[0] + sizeMax) / resolution)) - resolution * 0.49;
-  maxPoint[1] = resolution * (std::ceil((box.bottomCenter[1] + sizeMax) / resolution)) - resolution * 0.49;
-  maxPoint[2] = resolution * (std::ceil((box.bottomCenter[2] + box.size[2]) / resolution)) - resolution * 0.49;
+  const size_t last = next - 5;
+  const double weight = (time - keyframes[last]) / (keyframes[next] - keyframes[last]);
+  for (int i = 0; i < 4; ++i)
+    pose[i] = (1.0 - weight) * keyframes[last + 1 + i] + weight * keyframes[next + 1 + i];
+}
+
+bool WorldCreator::addAnimatedObjects(double time, const std::vector<ColumnWorld> &prototypeColumns, ColumnWorld &frame)
+{
+  //rotated objects are moved primitive by primitive and rasterized in place
+  const double origin[3] = {0.0, 0.0, 0.0};
+  PrimitiveStore moved;
+  frame.reset(resolution);
 
-  for (double x = minPoint[0]; x <= maxPoint[0]; x += resolution)
+  for (int i = 0; i < animations.size(); ++i)
   {
-    for (double y = minPoint[1]; y <= maxPoint[1]; y += resolution)
-    {
-      for (double z = minPoint[2]; z <= maxPoint[2]; z += resolution)
-      {
-        const double xTrans = (x - box.bottomCenter[0]) * cos(-box.angle) - (y - box.bottomCenter[1]) * sin(-box.angle);
-        const double yTrans = (x - box.bottomCenter[0]) * sin(-box.angle) + (y - box.bottomCenter[1]) * cos(-box.angle);
+    double pose[4];
+    int keyOffset[3];
+    getAnimationPose(animations[i], time, pose);
 
-        if (xTrans >= -0.5 * box.size[0] && xTrans <= 0.5 * box.size[0] && yTrans >= -0.5 * box.size[1] && yTrans <= 0.5 * box.size[1]
-            && z >= box.bottomCenter[2] && z <= box.bottomCenter[2] + box.size[2])
-          octree.updateNode(octomap::point3d(x, y, z), true, true);
-      }
-    }
+    if (pose[3] == 0.0 && getKeyOffset(pose, keyOffset))
+      frame.stamp(prototypeColumns[animations[i].prototype], keyOffset[0], keyOffset[1], keyOffset[2]);
+    else
+      addTransformedPrimitives(prototypes[animations[i].prototype].primitives, pose, moved);
   }
+
+  VoxelizationQueue queue;
+  queue.addPrimitives(frame, moved, origin);
+  if (!queue.run())
+    return false;
+
+  frame.compact();
+  return true;
 }
 
-void WorldCreator::addOctreeSphere(octomap::OcTree &octree, ObjectSphere &sphere)
+bool WorldCreator::createOctree()
 {
-  double minPoint[3], maxPoint[3];
+  if (!canCreateOctomap)
+  {
+    std::cout << "Cannot create octree files, because not all necessary parameters have been set. Need 'resolution' and at least one object." << std::endl;
+    return false;
+  }
 
-  minPoint[0] = resolution * (std::floor((sphere.bottom[0] - sphere.radius) / resolution)) + resolution * 0.49;
-  minPoint[1] = resolution * (std::floor((sphere.bottom[1] - sphere.radius) / resolution)) + resolution * 0.49;
-  minPoint[2] = resolution * (std::floor((sphere.bottom[2]) / resolution)) + resolution * 0.49;
+  if (!buildOctree())
+  {
+    puts("Terminated. No octomap created!\n");
+    return false;
+  }
 
-  maxPoint[0] = resolution * (std::ceil((sphere.bottom[0] + sphere.radius) / resolution)) - resolution * 0.49;
-  maxPoint[1] = resolution * (std::ceil((sphere.bottom[1] + sphere.radius) / resolution)) - resolution * 0.49;
-  maxPoint[2] = resolution * (std::ceil((sphere.bottom[2] + 2 * sphere.radius) / resolution)) - resolution * 0.49;
+  CompressedOutputFile binaryFile, file;
+  if (!openOutputFile(fileName + ".bt", binaryFile))
+    return false;
+  octree->writeBinary(binaryFile);
+  if (!closeOutputFile(binaryFile) || !openOutputFile(fileName + ".ot", file))
+    return false;
+  octree->write(file);
+  return closeOutputFile(file);
+}
 
-  for (double x = minPoint[0]; x <= maxPoint[0]; x += resolution)
+bool WorldCreator::openOutputFile(const std::string &name, CompressedOutputFile &file)
+{
+  if (file.open(name, compression, compressionLevel))
+    return true;
+
+  std::cout << "Cannot open output file '" << file.getFileName() << "'." << std::endl;
+  return false;
+}
+
+bool WorldCreator::closeOutputFile(CompressedOutputFile &file)
+{
+  if (!file.close())
   {
-    for (double y = minPoint[1]; y <= maxPoint[1]; y += resolution)
-    {
-      for (double z = minPoint[2]; z <= maxPoint[2]; z += resolution)
-      {
-        if ((x - sphere.bottom[0]) * (x - sphere.bottom[0]) + (y - sphere.bottom[1]) * (y - sphere.bottom[1])
-            + (z - sphere.bottom[2] - sphere.radius) * (z - sphere.bottom[2] - sphere.radius) <= sphere.radius * sphere.radius)
-          octree.updateNode(octomap::point3d(x, y, z), true, true);
-      }
-    }
+    std::cout << "Cannot write output file '" << file.getFileName() << "'." << std::endl;
+    return false;
   }
+
+  uncompressedBytes += file.getInputBytes();
+  compressedBytes += file.getOutputBytes();
+  return true;
+}
+
+bool WorldCreator::buildOctree()
+{
+  if (!hasColumns && !createColumnWorld())
+    return false;
+
+  //the bulk tree is pruned by construction, free space is inserted as coarse cubes
+  delete octree;
+  BulkOcTree *bulkOctree = new BulkOcTree(resolution);
+  bulkOctree->insertColumns(columns, markFreeSpace);
+  octree = bulkOctree;
+  return true;
 }
 
-void WorldCreator::addOctreeCylinder(octomap::OcTree &octree, ObjectCylinder &cylinder)
+bool WorldCreator::serveQueries(int numThreads)
 {
-  double minPoint[3], maxPoint[3];
+  if (!canCreateOctomap)
+  {
+    std::cout << "Cannot serve queries, because not all necessary parameters have been set. Need 'resolution' and at least one object." << std::endl;
+    return false;
+  }
+
+  if (octree == NULL && !buildOctree())
+  {
+    puts("Terminated. No queries served!\n");
+    return false;
+  }
 
-  minPoint[0] = resolution * (std::floor((cylinder.bottom[0] - cylinder.radius) / resolution)) + resolution * 0.49;
-  minPoint[1] = resolution * (std::floor((cylinder.bottom[1] - cylinder.radius) / resolution)) + resolution * 0.49;
-  minPoint[2] = resolution * (std::floor((cylinder.bottom[2]) / resolution)) + resolution * 0.49;
+  QueryServer server(*octree, numThreads);
+  ROS_INFO("Serving queries on '~query_world' (%zu octree nodes).", octree->size());
+  ros::spin();
+  return true;
+}
 
-  maxPoint[0] = resolution * (std::ceil((cylinder.bottom[0] + cylinder.radius) / resolution)) - resolution * 0.49;
-  maxPoint[1] = resolution * (std::ceil((cylinder.bottom[1] + cylinder.radius) / resolution)) - resolution * 0.49;
-  maxPoint[2] = resolution * (std::ceil((cylinder.bottom[2] + cylinder.height) / resolution)) - resolution * 0.49;
+bool WorldCreator::createMesh(bool obj)
+{
+  if (!canCreateOctomap)
+  {
+    std::cout << "Cannot create mesh, because not all necessary parameters have been set. Need 'resolution' and at least one object." << std::endl;
+    return false;
+  }
+
+  if (!hasColumns && !createColumnWorld())
+  {
+    puts("Terminated. No mesh created!\n");
+    return false;
+  }
 
-  for (double x = minPoint[0]; x <= maxPoint[0]; x += resolution)
+  MeshExporter exporter(columns);
+  const std::string meshFileName = fileName + (obj ? ".obj" : ".stl");
+  bool success = false;
+  if (compression == COMPRESSION_NONE && !obj)
   {
-    for (double y = minPoint[1]; y <= maxPoint[1]; y += resolution)
+    //plain stl files get their triangle count patched in, which saves the counting pass, but needs a seekable stream
+    std::ofstream file(meshFileName.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
     {
-      for (double z = minPoint[2]; z <= maxPoint[2]; z += resolution)
-      {
-        if ((x - cylinder.bottom[0]) * (x - cylinder.bottom[0]) + (y - cylinder.bottom[1]) * (y - cylinder.bottom[1]) <= cylinder.radius * cylinder.radius
-            && z <= cylinder.bottom[2] + cylinder.height && z >= cylinder.bottom[2])
-          octree.updateNode(octomap::point3d(x, y, z), true, true);
-      }
+      std::cout << "Cannot open output file '" << meshFileName << "'." << std::endl;
+      return false;
+    }
+    success = exporter.writeSTL(file);
+    const std::streampos size = file.tellp();
+    file.close();
+    if (!success || file.fail())
+    {
+      std::cout << "Cannot write output file '" << meshFileName << "'." << std::endl;
+      return false;
     }
+    uncompressedBytes += size;
+    compressedBytes += size;
   }
+  else
+  {
+    CompressedOutputFile file;
+    if (!openOutputFile(meshFileName, file))
+      return false;
+    success = obj ? exporter.writeOBJ(file) : exporter.writeSTL(file);
+    success = closeOutputFile(file) && success;
+  }
+
+  if (success)
+    ROS_INFO("Wrote %zu triangles.", exporter.getNumTriangles());
+  return success;
 }
 
 bool WorldCreator::createPNG()
@@ -729,8 +1637,11 @@ bool WorldCreator::createPNG()
     return false;
   }
 
-  if (octree == NULL)
-    createOctree();
+  if (!hasColumns && !createColumnWorld())
+  {
+    puts("Terminated. No png created!\n");
+    return false;
+  }
 
   createOccupancyMapFromOctomap();
 
@@ -747,54 +1658,21 @@ bool WorldCreator::createPNG()
 
 void WorldCreator::createOccupancyMapFromOctomap()
 {
-  int octreeKeyMinX, octreeKeyMinY, octreeKeyMinZ;
-  int octreeKeyMaxX, octreeKeyMaxY, octreeKeyMaxZ;
-
-  double mapResolutionRecip = 1.0 / resolution;
-
-  octomap::OcTreeKey keyMinPlane = octree->coordToKey(minX + resolution * 0.5, minY + resolution * 0.5, minZ + resolution * 0.5);
-  octomap::OcTreeKey keyMaxPlane = octree->coordToKey(maxX - resolution * 0.5, maxY - resolution * 0.5, maxZ - resolution * 0.5);
-
-  octreeKeyMinX = keyMinPlane[0];
-  octreeKeyMinY = keyMinPlane[1];
-  octreeKeyMaxX = keyMaxPlane[0];
-  octreeKeyMaxY = keyMaxPlane[1];
-  octreeKeyMinZ = keyMinPlane[2];
-  octreeKeyMaxZ = keyMaxPlane[2];
+  const octomap::key_type keyMinX = columns.getMinKey(0);
+  const octomap::key_type keyMinY = columns.getMinKey(1);
+  const octomap::key_type keyMinZ = columns.coordToKey(minZ + resolution * 0.5);
+  const octomap::key_type keyMaxZ = columns.coordToKey(maxZ - resolution * 0.5);
 
   occupancyMap.clear();
-  occupancyMap.resize(octreeKeyMaxX - octreeKeyMinX + 1, std::vector<bool>(octreeKeyMaxY - octreeKeyMinY + 1, false));
+  occupancyMap.resize(columns.getMaxKey(0) - keyMinX + 1, std::vector<bool>(columns.getMaxKey(1) - keyMinY + 1, false));
 
-  octomap::OcTreeKey key;
   for (int x = 0; x < occupancyMap.size(); ++x)
   {
     for (int y = 0; y < occupancyMap[0].size(); ++y)
-    {
-      for (int z = 0; z < octreeKeyMaxZ - octreeKeyMinZ; ++z)
-      {
-        key[0] = x + octreeKeyMinX;
-        key[1] = y + octreeKeyMinY;
-        key[2] = z + octreeKeyMinZ;
-        if (isOctreeNodeOccupied(key))
-        {
-          occupancyMap[x][y] = true;
-          z = octreeKeyMaxZ - octreeKeyMinZ;
-        }
-      }
-    }
+      occupancyMap[x][y] = columns.isBandOccupied(keyMinX + x, keyMinY + y, keyMinZ, keyMaxZ);
   }
 }
 
-bool WorldCreator::isOctreeNodeOccupied(const octomap::OcTreeKey &key) const
-{
-  octomap::OcTreeNode* node = octree->search(key);
-
-  if (node != NULL)
-    return octree->isNodeOccupied(node);
-  else
-    return false;
-}
-
 void WorldCreator::writeDataToPNM(std::ofstream &file)
 {
   file << "P1" << std::endl;
@@ -816,3 +1694,93 @@ void WorldCreator::writeDataToPNM(std::ofstream &file)
     file << std::endl;
   }
 }
+
+bool WorldCreator::createScans()
+{
+  if (scans.empty() || (primitives.empty() && instances.empty()))
+  {
+    std::cout << "Cannot create scans, because not all necessary parameters have been set. Need at least one scan and one object." << std::endl;
+    return false;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  const double origin[3] = {0.0, 0.0, 0.0};
+  ScanSimulator simulator;
+  simulator.addPrimitives(primitives, origin);
+  for (int i = 0; i < instances.size(); ++i)
+    simulator.addPrimitives(prototypes[instances[i].prototype].primitives, instances[i].offset);
+
+  //the floor matches the one of the voxel outputs: one voxel thick below minZ under all primitives
+  PrimitiveStore floor;
+  if (addFloor)
+  {
+    double min[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL}, max[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+    extendPrimitiveBounds(primitives, origin, min, max);
+    for (int i = 0; i < instances.size(); ++i)
+      extendPrimitiveBounds(prototypes[instances[i].prototype].primitives, instances[i].offset, min, max);
+
+    ObjectBox floorBox;
+    floorBox.name = "floor";
+    floorBox.bottomCenter[0] = 0.5 * (min[0] + max[0]);
+    floorBox.bottomCenter[1] = 0.5 * (min[1] + max[1]);
+    floorBox.bottomCenter[2] = minZ - resolution;
+    floorBox.size[0] = max[0] - min[0];
+    floorBox.size[1] = max[1] - min[1];
+    floorBox.size[2] = resolution;
+    floorBox.angle = 0.0;
+    floor.addBox(floorBox);
+    simulator.addPrimitives(floor, origin);
+  }
+  simulator.build();
+
+  ThreadPool pool(numThreads);
+  for (int i = 0; i < scans.size(); ++i)
+  {
+    const std::chrono::steady_clock::time_point scanStart = std::chrono::steady_clock::now();
+    CompressedOutputFile file;
+    if (!openOutputFile(fileName + "_" + scans[i].name + ".scan", file))
+      return false;
+    simulator.writeScan(scans[i], file, pool);
+    if (!closeOutputFile(file))
+      return false;
+
+    if (verbose)
+    {
+      std::vector<double> directions;
+      ScanSimulator::getRayDirections(scans[i], directions);
+      const double rays = static_cast<double>(directions.size() / 3) * (scans[i].poses.size() / 6);
+      ROS_INFO("Cast %.0f rays for scan '%s' (%.1f million rays per second).", rays, scans[i].name.c_str(),
+               rays / std::max(secondsSince(scanStart), 1e-9) * 1e-6);
+    }
+  }
+
+  if (verbose)
+    ROS_INFO("Scanned %zu primitives in %.3f s.", simulator.getNumPrimitives(), secondsSince(start));
+  return true;
+}
+
+void WorldCreator::printStats() const
+{
+  size_t numPrimitives = primitives.size(), primitiveMemory = primitives.memoryUsage();
+  for (int i = 0; i < prototypes.size(); ++i)
+  {
+    numPrimitives += prototypes[i].primitives.size();
+    primitiveMemory += prototypes[i].primitives.memoryUsage();
+  }
+
+  printf("primitives:       %zu (+ %zu instances)\n", numPrimitives, instances.size());
+  printf("primitive memory: %zu bytes (%.1f bytes per primitive, %zu byte scalars)\n", primitiveMemory,
+         numPrimitives > 0 ? static_cast<double>(primitiveMemory) / numPrimitives : 0.0, sizeof(PrimitiveScalar));
+  printf("parse time:       %.3f s\n", parseSeconds);
+  if (hasColumns)
+  {
+    printf("voxelize time:    %.3f s\n", voxelizeSeconds);
+    printf("column runs:      %zu (%zu bytes%s)\n", columns.getNumRuns(), columns.memoryUsage(),
+           columns.hasDenseGrid() ? " including the dense grid" : "");
+  }
+  if (compression != COMPRESSION_NONE && compressedBytes > 0)
+  {
+    printf("compression:      %s level %d, %.1f MB written as %.1f MB (ratio %.2f)\n", CompressedOutputFile::getName(compression).c_str(),
+           compressionLevel, uncompressedBytes / 1048576.0, compressedBytes / 1048576.0, static_cast<double>(uncompressedBytes) / compressedBytes);
+  }
+}
@@ -0,0 +1,131 @@
+#include <simple_world_creator/thread_pool.h>
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int numThreads) :
+    remainingJobs(0), generation(0), stopping(false)
+{
+  if (numThreads <= 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 0; i < numThreads; ++i)
+    queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+
+  for (int i = 0; i < numThreads; ++i)
+    threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  workCondition.notify_all();
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+}
+
+int ThreadPool::getNumThreads() const
+{
+  return threads.size();
+}
+
+void ThreadPool::run(std::vector<Job> &jobs)
+{
+  if (jobs.empty())
+    return;
+
+  //counted before queueing, since workers still draining their queues may pick jobs up right away
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    remainingJobs += jobs.size();
+  }
+
+  //round-robin distribution; uneven job sizes are balanced by stealing
+  for (size_t i = 0; i < jobs.size(); ++i)
+  {
+    WorkQueue &queue = *queues[i % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(jobs[i]);
+  }
+
+  std::unique_lock<std::mutex> lock(stateMutex);
+  ++generation;
+  workCondition.notify_all();
+
+  while (remainingJobs > 0)
+    doneCondition.wait(lock);
+}
+
+void ThreadPool::parallelFor(size_t size, size_t grainSize, const std::function<void(size_t begin, size_t end, int worker)> &function)
+{
+  grainSize = std::max<size_t>(1, grainSize);
+
+  std::vector<Job> jobs;
+  jobs.reserve((size + grainSize - 1) / grainSize);
+  for (size_t begin = 0; begin < size; begin += grainSize)
+  {
+    const size_t end = std::min(size, begin + grainSize);
+    jobs.push_back([&function, begin, end](int worker)
+    { function(begin, end, worker);});
+  }
+
+  run(jobs);
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+  size_t seenGeneration = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      while (!stopping && seenGeneration == generation)
+        workCondition.wait(lock);
+
+      if (stopping)
+        return;
+      seenGeneration = generation;
+    }
+
+    Job job;
+    while (popJob(worker, job))
+    {
+      job(worker);
+
+      std::lock_guard<std::mutex> lock(stateMutex);
+      if (--remainingJobs == 0)
+        doneCondition.notify_all();
+    }
+  }
+}
+
+bool ThreadPool::popJob(int worker, Job &job)
+{
+  {
+    WorkQueue &own = *queues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty())
+    {
+      job = own.jobs.back();
+      own.jobs.pop_back();
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < queues.size(); ++i)
+  {
+    WorkQueue &victim = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty())
+    {
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,180 @@
+#include <simple_world_creator/voxelization_queue.h>
+#include <simple_world_creator/shape_kernels.h>
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+VoxelizationQueue::VoxelizationQueue() :
+    timeBudget(0.0), maxVoxelsPerJob(1e6), estimatedVoxels(0.0), timeBudgetExceeded(false)
+{
+}
+
+void VoxelizationQueue::setProgressCallback(const VoxelizationProgressCallback &callback)
+{
+  progressCallback = callback;
+}
+
+void VoxelizationQueue::setTimeBudget(double seconds)
+{
+  timeBudget = seconds;
+}
+
+void VoxelizationQueue::setMaxVoxelsPerJob(double voxels)
+{
+  maxVoxelsPerJob = std::max(1.0, voxels);
+}
+
+void VoxelizationQueue::addPrimitives(ColumnWorld &target, const PrimitiveStore &primitives, const double offset[3])
+{
+  addJobs<BoxKernel>(target, primitives, offset);
+  addJobs<SphereKernel>(target, primitives, offset);
+  addJobs<CylinderKernel>(target, primitives, offset);
+  addJobs<PolygonPrismKernel>(target, primitives, offset);
+  addJobs<CapsuleKernel>(target, primitives, offset);
+}
+
+void VoxelizationQueue::addTask(const std::function<void()> &task, double estimatedVoxels)
+{
+  Job job;
+  job.target = NULL;
+  job.primitives = NULL;
+  job.rasterize = NULL;
+  job.begin = job.end = 0;
+  job.slabBegin = job.slabEnd = 0;
+  job.task = task;
+  job.estimatedVoxels = estimatedVoxels;
+  jobs.push_back(job);
+  this->estimatedVoxels += estimatedVoxels;
+}
+
+bool VoxelizationQueue::run()
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  timeBudgetExceeded = false;
+
+  VoxelizationProgress progress;
+  progress.voxelsDone = 0.0;
+  progress.voxelsTotal = estimatedVoxels;
+
+  for (size_t i = 0; i < jobs.size(); ++i)
+  {
+    const Job &job = jobs[i];
+    if (job.task)
+      job.task();
+    else
+      job.rasterize(*job.target, *job.primitives, job.begin, job.end, job.offset, job.slabBegin, job.slabEnd);
+
+    progress.voxelsDone += jobs[i].estimatedVoxels;
+    progress.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    progress.remainingSeconds =
+        progress.voxelsDone > 0.0 ? progress.elapsedSeconds * (progress.voxelsTotal - progress.voxelsDone) / progress.voxelsDone : 0.0;
+
+    if (progressCallback)
+      progressCallback(progress);
+
+    if (!ros::ok())
+      return false;
+
+    if (timeBudget > 0.0 && progress.elapsedSeconds > timeBudget && i + 1 < jobs.size())
+    {
+      timeBudgetExceeded = true;
+      return false;
+    }
+  }
+
+  jobs.clear();
+  return true;
+}
+
+bool VoxelizationQueue::isTimeBudgetExceeded() const
+{
+  return timeBudgetExceeded;
+}
+
+double VoxelizationQueue::getEstimatedVoxels() const
+{
+  return estimatedVoxels;
+}
+
+template<typename Kernel>
+void VoxelizationQueue::addJobs(ColumnWorld &target, const PrimitiveStore &primitives, const double offset[3])
+{
+  const typename Kernel::Columns &columns = Kernel::getColumns(primitives);
+  const double voxelVolume = std::pow(target.getResolution(), 3);
+
+  Job job;
+  job.target = &target;
+  job.primitives = &primitives;
+  std::copy(offset, offset + 3, job.offset);
+  job.rasterize = &rasterize<Kernel>;
+  job.begin = 0;
+  job.slabBegin = 0;
+  job.slabEnd = ColumnWorld::KEY_LIMIT;
+  job.estimatedVoxels = 0.0;
+
+  for (size_t i = 0; i < columns.size(); ++i)
+  {
+    const double voxels = Kernel::getVolume(columns, i) / voxelVolume;
+    estimatedVoxels += voxels;
+
+    if (voxels <= maxVoxelsPerJob)
+    {
+      //small primitives are grouped until the group reaches the job size
+      job.estimatedVoxels += voxels;
+      if (job.estimatedVoxels >= maxVoxelsPerJob)
+      {
+        job.end = i + 1;
+        jobs.push_back(job);
+        job.begin = i + 1;
+        job.estimatedVoxels = 0.0;
+      }
+      continue;
+    }
+
+    if (job.begin < i)
+    {
+      job.end = i;
+      jobs.push_back(job);
+    }
+
+    //large primitives are cut into slabs of x keys of roughly maxVoxelsPerJob each
+    typename Kernel::Shape shape;
+    Kernel::getShape(columns, i, offset, shape);
+    int xBegin, xEnd;
+    if (target.coordsToKeySpan(shape.min[0], shape.max[0], xBegin, xEnd))
+    {
+      const double voxelsPerSlice = voxels / (xEnd - xBegin);
+      const int slabWidth = std::max(1, static_cast<int>(maxVoxelsPerJob / voxelsPerSlice));
+
+      Job slab = job;
+      slab.begin = i;
+      slab.end = i + 1;
+      for (int x = xBegin; x < xEnd; x += slabWidth)
+      {
+        slab.slabBegin = x;
+        slab.slabEnd = std::min<int>(x + slabWidth, xEnd);
+        slab.estimatedVoxels = voxelsPerSlice * (slab.slabEnd - slab.slabBegin);
+        jobs.push_back(slab);
+      }
+    }
+
+    job.begin = i + 1;
+    job.estimatedVoxels = 0.0;
+  }
+
+  if (job.begin < columns.size())
+  {
+    job.end = columns.size();
+    jobs.push_back(job);
+  }
+}
+
+template<typename Kernel>
+void VoxelizationQueue::rasterize(ColumnWorld &target, const PrimitiveStore &primitives, size_t begin, size_t end, const double offset[3],
+                                  int slabBegin, int slabEnd)
+{
+  target.addShapes<Kernel>(Kernel::getColumns(primitives), begin, end, offset, slabBegin, slabEnd);
+}
@@ -0,0 +1,225 @@
+#include <simple_world_creator/world_query.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+double getDistanceSquaredToCube(const double point[3], const double min[3], double size)
+{
+  double distanceSquared = 0.0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    const double distance = std::max(std::max(min[axis] - point[axis], point[axis] - min[axis] - size), 0.0);
+    distanceSquared += distance * distance;
+  }
+  return distanceSquared;
+}
+}
+
+WorldQuery::WorldQuery(const octomap::OcTree &octree, int numThreads) :
+    octree(octree), pool(numThreads)
+{
+  //the root cube spans all keys, centered on the origin
+  root.node = octree.getRoot();
+  root.size = octree.getResolution() * static_cast<double>(1 << octree.getTreeDepth());
+  root.min[0] = root.min[1] = root.min[2] = -0.5 * root.size;
+}
+
+void WorldQuery::queryPoints(const double *points, size_t n, int8_t *states)
+{
+  pool.parallelFor(n, GRAIN_SIZE, [&](size_t begin, size_t end, int)
+  {
+    for (size_t i = begin; i < end; ++i)
+      states[i] = getState(&points[3 * i]);
+  });
+}
+
+void WorldQuery::queryBoxes(const double *boxes, size_t n, uint8_t *occupied)
+{
+  pool.parallelFor(n, GRAIN_SIZE, [&](size_t begin, size_t end, int)
+  {
+    for (size_t i = begin; i < end; ++i)
+      occupied[i] = isBoxOccupied(&boxes[6 * i], &boxes[6 * i + 3]);
+  });
+}
+
+void WorldQuery::castRays(const double *rays, size_t n, double maxRange, float *ranges)
+{
+  pool.parallelFor(n, GRAIN_SIZE, [&](size_t begin, size_t end, int)
+  {
+    for (size_t i = begin; i < end; ++i)
+      ranges[i] = castRay(&rays[6 * i], &rays[6 * i + 3], maxRange);
+  });
+}
+
+void WorldQuery::queryDistances(const double *points, size_t n, double maxDistance, float *distances)
+{
+  pool.parallelFor(n, GRAIN_SIZE, [&](size_t begin, size_t end, int)
+  {
+    for (size_t i = begin; i < end; ++i)
+      distances[i] = getDistance(&points[3 * i], maxDistance);
+  });
+}
+
+int WorldQuery::getState(const double point[3]) const
+{
+  //search() stops at pruned leaves, so uniform regions are answered near the root
+  octomap::OcTreeKey key;
+  if (!octree.coordToKeyChecked(octomap::point3d(point[0], point[1], point[2]), key))
+    return STATE_UNKNOWN;
+
+  const octomap::OcTreeNode *node = octree.search(key);
+  if (node == NULL)
+    return STATE_UNKNOWN;
+  return octree.isNodeOccupied(node) ? STATE_OCCUPIED : STATE_FREE;
+}
+
+bool WorldQuery::isBoxOccupied(const double min[3], const double max[3]) const
+{
+  return root.node != NULL && isBoxOccupied(root, min, max);
+}
+
+double WorldQuery::castRay(const double origin[3], const double direction[3], double maxRange) const
+{
+  const double length = sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+  if (root.node == NULL || length == 0.0)
+    return std::numeric_limits<double>::quiet_NaN();
+
+  //with normalized directions the ray parameter is the metric range
+  double inverseDirection[3];
+  unsigned int childMask = 0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    inverseDirection[axis] = length / direction[axis];
+    if (direction[axis] < 0.0)
+      childMask |= 1 << axis;
+  }
+
+  double t = maxRange;
+  castRay(root, origin, inverseDirection, childMask, t);
+  return t < maxRange ? t : std::numeric_limits<double>::quiet_NaN();
+}
+
+double WorldQuery::getDistance(const double point[3], double maxDistance) const
+{
+  double distanceSquared = maxDistance * maxDistance;
+  if (root.node != NULL)
+    getDistanceSquared(root, point, distanceSquared);
+  return std::min(sqrt(distanceSquared), maxDistance);
+}
+
+void WorldQuery::getChild(const Cube &cube, unsigned int i, Cube &child) const
+{
+  //child index bits select the upper half along x (1), y (2) and z (4)
+  child.node = octree.getNodeChild(cube.node, i);
+  child.size = 0.5 * cube.size;
+  for (int axis = 0; axis < 3; ++axis)
+    child.min[axis] = cube.min[axis] + ((i >> axis) & 1) * child.size;
+}
+
+bool WorldQuery::isCubeFree(const Cube &cube) const
+{
+  return !octree.isNodeOccupied(cube.node);
+}
+
+bool WorldQuery::isBoxOccupied(const Cube &cube, const double min[3], const double max[3]) const
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (cube.min[axis] > max[axis] || cube.min[axis] + cube.size <= min[axis])
+      return false;
+  }
+
+  if (isCubeFree(cube))
+    return false;
+  if (!octree.nodeHasChildren(cube.node))
+    return true;
+
+  Cube child;
+  for (unsigned int i = 0; i < 8; ++i)
+  {
+    if (!octree.nodeChildExists(cube.node, i))
+      continue;
+    getChild(cube, i, child);
+    if (isBoxOccupied(child, min, max))
+      return true;
+  }
+  return false;
+}
+
+void WorldQuery::castRay(const Cube &cube, const double origin[3], const double inverseDirection[3], unsigned int childMask, double &t) const
+{
+  //t is the closest hit so far, cubes entered behind it are skipped
+  double begin = 0.0, end = t;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (std::isinf(inverseDirection[axis]))
+    {
+      if (origin[axis] < cube.min[axis] || origin[axis] >= cube.min[axis] + cube.size)
+        return;
+      continue;
+    }
+
+    double t0 = (cube.min[axis] - origin[axis]) * inverseDirection[axis];
+    double t1 = (cube.min[axis] + cube.size - origin[axis]) * inverseDirection[axis];
+    if (t0 > t1)
+      std::swap(t0, t1);
+    begin = std::max(begin, t0);
+    end = std::min(end, t1);
+  }
+
+  if (begin > end || begin >= t || isCubeFree(cube))
+    return;
+
+  if (!octree.nodeHasChildren(cube.node))
+  {
+    t = begin;
+    return;
+  }
+
+  //children on the side the ray comes from are visited first, so later ones are mostly culled by t
+  Cube child;
+  for (unsigned int i = 0; i < 8; ++i)
+  {
+    const unsigned int c = i ^ childMask;
+    if (!octree.nodeChildExists(cube.node, c))
+      continue;
+    getChild(cube, c, child);
+    castRay(child, origin, inverseDirection, childMask, t);
+  }
+}
+
+void WorldQuery::getDistanceSquared(const Cube &cube, const double point[3], double &distanceSquared) const
+{
+  const double cubeDistanceSquared = getDistanceSquaredToCube(point, cube.min, cube.size);
+  if (cubeDistanceSquared >= distanceSquared || isCubeFree(cube))
+    return;
+
+  if (!octree.nodeHasChildren(cube.node))
+  {
+    distanceSquared = cubeDistanceSquared;
+    return;
+  }
+
+  //closest children first, so that the bound tightens before the far ones are visited
+  std::pair<double, unsigned int> children[8];
+  int numChildren = 0;
+  Cube child;
+  for (unsigned int i = 0; i < 8; ++i)
+  {
+    if (!octree.nodeChildExists(cube.node, i))
+      continue;
+    getChild(cube, i, child);
+    children[numChildren++] = std::make_pair(getDistanceSquaredToCube(point, child.min, child.size), i);
+  }
+  std::sort(children, children + numChildren);
+
+  for (int i = 0; i < numChildren && children[i].first < distanceSquared; ++i)
+  {
+    getChild(cube, children[i].second, child);
+    getDistanceSquared(child, point, distanceSquared);
+  }
+}